@@ -0,0 +1,142 @@
+#ifndef __BENCH_H__
+    #define __BENCH_H__
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+    Bench: the tiny harness shared by the host benchmarks.
+    Every case reports ns/op and bytes moved per op, as a table with the bytes/s where bytes move, or as JSON lines with --json.
+    --baseline <file> compares against JSON lines of an earlier run and fails the process on a regression
+    over --tolerance percent (25 by default), --quick cuts the iteration counts for smoke runs.
+*/
+namespace bench
+{
+
+struct Result
+{
+    std::string name;       // what is measured
+    std::string param;      // the varied parameter, e.g. "task_size=16"
+    uint64_t ops;
+    double ns_per_op;
+    double bytes_per_op;    // bytes copied into or out of the loop's storage by one op
+};
+
+// keeps the optimizer from dropping what a benchmark computes
+template<typename T>
+inline void doNotOptimize(const T& value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+inline uint64_t nowNs()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+class Suite
+{
+private:
+    std::vector<Result> m_results;
+    bool m_json = false;
+    bool m_quick = false;
+    const char* m_baseline = nullptr;
+    double m_tolerance = 25;
+    int m_repeats = 5;
+public:
+    Suite(int argc, char** argv)
+    {
+        for(int i=1; i<argc; i++)
+        {
+            if(!strcmp(argv[i], "--json"))
+                m_json = true;
+            else if(!strcmp(argv[i], "--quick"))
+                m_quick = true;
+            else if(!strcmp(argv[i], "--baseline") && i+1 < argc)
+                m_baseline = argv[++i];
+            else if(!strcmp(argv[i], "--tolerance") && i+1 < argc)
+                m_tolerance = atof(argv[++i]);
+            else
+            {
+                fprintf(stderr, "usage: %s [--json] [--quick] [--baseline file] [--tolerance percent]\n", argv[0]);
+                exit(2);
+            }
+        }
+        if(m_quick)
+            m_repeats = 1;
+    }
+
+    bool quick() const { return m_quick; }
+    // scale an iteration count down for --quick
+    uint64_t iterations(uint64_t n) const { return m_quick ? (n/100 ? n/100 : 1) : n; }
+
+    // body(ops) runs ops operations, the best of the repeats is kept since noise only ever adds time
+    template<typename Body>
+    void run(const std::string& name, const std::string& param, uint64_t ops, double bytes_per_op, Body body)
+    {
+        uint64_t best = UINT64_MAX;
+        for(int r=0; r<m_repeats; r++)
+        {
+            const uint64_t begin = nowNs();
+            body(ops);
+            const uint64_t spent = nowNs() - begin;
+            if(spent < best)
+                best = spent;
+        }
+        record(name, param, ops, (double)best/ops, bytes_per_op);
+    }
+    // for cases timing themselves, e.g. to leave out the setup of every op
+    void record(const std::string& name, const std::string& param, uint64_t ops, double ns_per_op, double bytes_per_op)
+    {
+        m_results.push_back(Result{name, param, ops, ns_per_op, bytes_per_op});
+        const Result& r = m_results.back();
+        if(m_json)
+            printf("{\"bench\":\"%s\",\"param\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+                   r.name.c_str(), r.param.c_str(), (unsigned long long)r.ops, r.ns_per_op, r.bytes_per_op);
+        else
+        {
+            printf("%-32s %-20s %10llu ops %10.2f ns/op %8.1f B/op",
+                   r.name.c_str(), r.param.c_str(), (unsigned long long)r.ops, r.ns_per_op, r.bytes_per_op);
+            if(r.bytes_per_op > 0 && r.ns_per_op > 0)
+                printf(" %10.1f MB/s", r.bytes_per_op*1000/r.ns_per_op);
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+
+    // 0 if there is no baseline or nothing regressed, 1 otherwise
+    int finish() const
+    {
+        if(!m_baseline)
+            return 0;
+        FILE* f = fopen(m_baseline, "r");
+        if(!f)
+        {
+            fprintf(stderr, "bench: cannot open baseline %s\n", m_baseline);
+            return 1;
+        }
+        int regressions = 0;
+        char line[512], name[128], param[128];
+        double ns;
+        while(fgets(line, sizeof(line), f))
+        {
+            if(sscanf(line, "{\"bench\":\"%127[^\"]\",\"param\":\"%127[^\"]\",\"ops\":%*u,\"ns_per_op\":%lf", name, param, &ns) != 3)
+                continue;
+            for(const Result& r : m_results)
+                if(r.name == name && r.param == param && r.ns_per_op > ns*(1+m_tolerance/100))
+                {
+                    fprintf(stderr, "bench: REGRESSION %s %s: %.2f ns/op, baseline %.2f\n", name, param, r.ns_per_op, ns);
+                    regressions++;
+                }
+        }
+        fclose(f);
+        return regressions ? 1 : 0;
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,108 @@
+#include <ctime>
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    Reading all the calendar fields of a clock display, through the accessors of Time which start over every time,
+    against CivilTime broken down once and against CivilTime walked forward by advance().
+    Before measuring, CivilTime is checked against the accessors of Time and gmtime_r() over 1970-2370,
+    a whole 400 year cycle of the calendar: every day built from scratch, and a walk in steps just under a minute
+    checked at every change of date and every 997th step. Any mismatch fails the process.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint64_t mismatches = 0;
+
+static void check(const CivilTime& civil)
+{
+    Time t = civil.time();
+    const time_t seconds = (uint64_t)t/1000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    const bool same = civil.getDate() == t.getDate()
+        && civil.getYear() == tm.tm_year+1900 && civil.getMonth() == tm.tm_mon+1 && civil.getDay() == tm.tm_mday
+        && civil.getWeekday() == t.getWeekday() && civil.getWeekday() == tm.tm_wday
+        && civil.getNthWeek() == t.getNthWeek() && civil.getDayOfYear() == tm.tm_yday
+        && civil.getHours() == t.getHours() && civil.getHours() == tm.tm_hour
+        && civil.getMinutes() == t.getMinutes() && civil.getMinutes() == tm.tm_min
+        && civil.getSeconds() == t.getSeconds() && civil.getSeconds() == tm.tm_sec
+        && civil.getMillis() == (uint64_t)t%1000;
+    if(!same && mismatches++ < 8)
+        fprintf(stderr, "bench_calendar: %llu ms is %04d-%02d-%02d %02d:%02d:%02d wd %d yd %d, CivilTime says %04u-%02u-%02u %02u:%02u:%02u wd %u yd %u\n",
+                (unsigned long long)(uint64_t)t, tm.tm_year+1900, tm.tm_mon+1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_wday, tm.tm_yday,
+                civil.getYear(), civil.getMonth(), civil.getDay(), civil.getHours(), civil.getMinutes(), civil.getSeconds(),
+                civil.getWeekday(), civil.getDayOfYear());
+}
+
+static void crossCheck(uint32_t years)
+{
+    const uint32_t days = years*146097/400;
+    for(uint32_t day=0; day<days; day++)
+        check(CivilTime(Time((uint64_t)day*86400000 + (uint64_t)day*7919%86400000)));
+
+    const uint64_t end = (uint64_t)days*86400000;
+    CivilTime civil;
+    uint8_t last_day = civil.getDay();
+    for(uint64_t step=0; (uint64_t)civil.time() < end; step++)
+    {
+        civil.advance(59999 - step%7);
+        if(civil.getDay() != last_day || step%997 == 0)
+            check(civil);
+        last_day = civil.getDay();
+    }
+}
+
+static uint32_t sink = 0;
+
+static void read(Time t)
+{
+    auto date = t.getDate();
+    sink += std::get<0>(date) + std::get<1>(date) + std::get<2>(date) + t.getWeekday() + t.getNthWeek()
+        + t.getHours() + t.getMinutes() + t.getSeconds();
+}
+static void read(const CivilTime& civil)
+{
+    auto date = civil.getDate();
+    sink += std::get<0>(date) + std::get<1>(date) + std::get<2>(date) + civil.getWeekday() + civil.getNthWeek()
+        + civil.getHours() + civil.getMinutes() + civil.getSeconds();
+}
+
+// one op is one second of a clock display reading all its fields
+static void benchFields(bench::Suite& suite)
+{
+    const uint64_t ops = suite.iterations(2000000);
+    const uint64_t start = 1700000000000ULL;
+    suite.run("calendar.fields", "from=Time", ops, sizeof(Time), [start](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            read(Time(start + i*1000));
+    });
+    suite.run("calendar.fields", "from=CivilTime(Time)", ops, sizeof(CivilTime), [start](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            read(CivilTime(Time(start + i*1000)));
+    });
+    suite.run("calendar.fields", "from=advance(1000)", ops, sizeof(CivilTime), [start](uint64_t ops){
+        CivilTime civil{Time(start)};
+        for(uint64_t i=0; i<ops; i++)
+        {
+            civil.advance(1000);
+            read(civil);
+        }
+    });
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+
+    crossCheck(suite.quick() ? 8 : 400);
+    if(mismatches)
+    {
+        fprintf(stderr, "bench_calendar: %llu mismatches, the results are not comparable\n", (unsigned long long)mismatches);
+        return 1;
+    }
+    benchFields(suite);
+
+    bench::doNotOptimize(sink);
+    return suite.finish();
+}
@@ -0,0 +1,158 @@
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    Resume cost of a coroutine suspended in co_await against the callback chain doing the same:
+    a timer chain where every step arms the next one, and an event that moves the work into the next pass.
+    Both sides run the same number of tasks through the same loop, the difference is the frame switch.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint64_t executed = 0;
+static uint64_t failures = 0;
+static bool running = false;
+
+static EventLoopHelperFunctions helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },
+    nullptr,
+};
+
+static constexpr uint32_t chains = 8;
+static EventLoop<1024, 32> loop(&helper_functions);
+static TaskInterface* handlers[chains];
+
+// timer chains: every step sleeps 1 ms, one runOnce(1) resumes all of them
+static Coroutine<chains> sleeper()
+{
+    while(running)
+    {
+        co_await loop.sleep(1);
+        executed++;
+    }
+}
+static void timeoutStep()
+{
+    executed++;
+    if(running)
+        loop.setTimeout(timeoutStep, 1);
+}
+
+// event chains: the handler is fired, the work runs in the next pass
+static Coroutine<chains> waiter(uint32_t i)
+{
+    while(running)
+    {
+        co_await loop.waitEvent(handlers[i]);
+        executed++;
+    }
+}
+static void eventStep() { executed++; }
+static void onEvent() { loop.nextTick(eventStep); }
+
+static void settle()
+{
+    running = false;
+    for(auto& handler : handlers)
+        if(handler)
+            handler->exec();
+    while(loop.hasPendingTasks())
+        loop.runOnce(1);
+}
+
+static void benchSleep(bench::Suite& suite)
+{
+    const uint64_t ops = suite.iterations(2000000)/chains*chains;
+    running = true;
+    for(uint32_t i=0; i<chains; i++)
+        loop.setTimeout(timeoutStep, 1);
+    suite.run("callback.timeout_chain", "chains=" + std::to_string(chains), ops, make_task(timeoutStep).transform<TimeoutTask>().size(),
+        [](uint64_t ops){
+            for(uint64_t i=0; i<ops; i+=chains)
+                loop.runOnce(1);
+        });
+    settle();
+
+    running = true;
+    for(uint32_t i=0; i<chains; i++)
+        if(!sleeper())
+            failures++;
+    suite.run("coro.sleep_resume", "chains=" + std::to_string(chains), ops, make_task(resumeCoroutine).setArgs({(void*)nullptr}).transform<TimeoutTask>().size(),
+        [](uint64_t ops){
+            for(uint64_t i=0; i<ops; i+=chains)
+                loop.runOnce(1);
+        });
+    settle();
+}
+
+static void benchEvent(bench::Suite& suite)
+{
+    const uint64_t ops = suite.iterations(2000000)/chains*chains;
+    running = true;
+    for(auto& handler : handlers)
+        loop.bindEventHandler(handler, onEvent);
+    suite.run("callback.event_nexttick", "chains=" + std::to_string(chains), ops, make_task(eventStep).size(),
+        [](uint64_t ops){
+            for(uint64_t i=0; i<ops; i+=chains)
+            {
+                for(auto handler : handlers)
+                    handler->exec();
+                loop.runOnce(0);    // what is pushed between passes runs in the second one
+                loop.runOnce(0);
+            }
+        });
+    for(auto& handler : handlers)
+        loop.clearEventHandler(handler);
+    settle();
+
+    // the coroutine binds the handler again on every wait, the callback keeps its binding
+    running = true;
+    for(uint32_t i=0; i<chains; i++)
+        if(!waiter(i))
+            failures++;
+    const uint64_t before = executed;
+    for(auto handler : handlers)
+    {   // fired twice before the pass, the coroutine still resumes once
+        handler->exec();
+        handler->exec();
+    }
+    loop.runOnce(0);
+    loop.runOnce(0);
+    if(executed - before != chains)
+    {
+        fprintf(stderr, "bench: %llu resumes for %u fired handlers, the results are not comparable\n",
+                (unsigned long long)(executed - before), chains);
+        exit(1);
+    }
+    suite.run("coro.event_resume", "chains=" + std::to_string(chains), ops, make_task(resumeCoroutine).setArgs({(void*)nullptr}).size(),
+        [](uint64_t ops){
+            for(uint64_t i=0; i<ops; i+=chains)
+            {
+                for(auto handler : handlers)
+                    handler->exec();
+                loop.runOnce(0);    // what is pushed between passes runs in the second one
+                loop.runOnce(0);
+            }
+        });
+    settle();
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+
+    benchSleep(suite);
+    benchEvent(suite);
+
+    const auto& frames = Coroutine<chains>::frames;
+    fprintf(stderr, "bench_coroutine: frames of %zu bytes, the largest asked for %zu, %u in use\n",
+            Coroutine<chains>::FramePool::FRAME_SIZE, frames.largestFrame(), frames.used());
+    bench::doNotOptimize(executed);
+    if(failures || frames.failed() || frames.used())
+    {
+        fprintf(stderr, "bench: %llu allocations failed, the results are not comparable\n", (unsigned long long)(failures + frames.failed()));
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,386 @@
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    Microbenchmarks of the loop itself: nextTick() push/run/pop, timer arm/fire/cancel,
+    event handler bookkeeping, the ring wrapping around at several taskbuf sizes, and the wakeups a timer mix takes.
+    Before measuring, timers clearing themselves from their own callback must run and be freed exactly once,
+    or the process fails.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint64_t executed = 0;
+static uint64_t failures = 0;
+
+static EventLoopHelperFunctions helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },   // onTaskAllocationFailed, any failure spoils the numbers
+    nullptr,
+};
+
+// tasks of growing size, the arguments are the payload
+static void task0() { executed++; }
+static void task16(int64_t a, int64_t b) { executed += a+b; }
+static void task32(int64_t a, int64_t b, int64_t c, int64_t d) { executed += a+b+c+d; }
+static void task64(int64_t a, int64_t b, int64_t c, int64_t d, int64_t e, int64_t f, int64_t g, int64_t h) { executed += a+b+c+d+e+f+g+h; }
+
+// push/run/pop of batches of tasks of one size, bytes moved is the size of the task copied into the ring
+template<typename Callable, typename ...Args>
+static void benchNextTick(bench::Suite& suite, Callable callable, Args... args)
+{
+    static EventLoop<4096, 0> loop(&helper_functions);
+    auto task = make_task(callable).setArgs({args...});
+    const std::size_t size = task.size();
+    const uint64_t batch = 4096/size/2;
+    suite.run("nextTick.push_run_pop", "task_size=" + std::to_string(size), suite.iterations(2000000)/batch*batch, size,
+        [&](uint64_t ops){
+            for(uint64_t done=0; done<ops; done+=batch)
+            {
+                for(uint64_t i=0; i<batch; i++)
+                    loop.nextTick(&task);
+                while(loop.hasPendingTasks())
+                    loop.runOnce(0);
+            }
+        });
+    // the same built in place, no task on the stack and no arguments copied through setArgs()
+    suite.run("emplaceTick.push_run_pop", "task_size=" + std::to_string(size), suite.iterations(2000000)/batch*batch, size,
+        [&](uint64_t ops){
+            for(uint64_t done=0; done<ops; done+=batch)
+            {
+                for(uint64_t i=0; i<batch; i++)
+                    loop.emplaceTick(callable, args...);
+                while(loop.hasPendingTasks())
+                    loop.runOnce(0);
+            }
+        });
+}
+
+// timers armed in the background, they re-arm themselves when they fire so their number stays the same
+using TimerLoop = EventLoop<768, 250, 64, 254>;
+static TimerLoop timer_loop(&helper_functions);
+static void rearm(uint32_t delay) { executed++; timer_loop.setTimeout(rearm, delay, delay); }
+static void fired() { executed++; }
+
+static void benchTimers(bench::Suite& suite, uint32_t armed)
+{
+    uint32_t seed = 12345;
+    for(uint32_t i=0; i<armed; i++)
+    {   // spread over every level of the wheel and the overflow list
+        seed = seed*1103515245 + 12345;
+        const uint32_t delay = 2 + (seed>>8)%40000;
+        timer_loop.setTimeout(rearm, delay, delay);
+    }
+    const std::string param = "armed=" + std::to_string(armed);
+    const double size = make_task(fired).transform<TimeoutTask>().size();
+
+    suite.run("setTimeout.arm_cancel", param, suite.iterations(2000000), size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            timer_loop.clearTimeout(timer_loop.setTimeout(fired, 5000));
+    });
+    suite.run("setTimeout.arm_fire", param, suite.iterations(1000000), size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+        {
+            timer_loop.setTimeout(fired, 1);
+            timer_loop.runOnce(1);
+        }
+    });
+    // a pass with nothing due, what every iteration of run() pays for the armed timers
+    suite.run("setTimeout.idle_pass", param, suite.iterations(5000000), 0, [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            timer_loop.runOnce(0);
+    });
+
+    while(timer_loop.findTimeout(rearm))
+        timer_loop.clearTimeout(rearm);
+}
+
+// the cost bound handlers add to every pass, then binding and firing one
+static EventLoop<768, 250, 64> event_loop(&helper_functions);
+static TaskInterface* handlers[250];
+static void onEvent(int32_t k) { executed += k; }
+static bool spinning = false;
+static void spin() { executed++; if(spinning) event_loop.nextTick(spin); }
+
+static void benchEvents(bench::Suite& suite, uint32_t bound)
+{
+    for(uint32_t i=0; i<bound; i++)
+        event_loop.bindEventHandler(handlers[i], onEvent, (int32_t)i);
+    const std::string param = "bound=" + std::to_string(bound);
+    const double size = make_task(onEvent).setArgs({0}).transform<EventTask>().size();
+
+    spinning = true;
+    event_loop.nextTick(spin);
+    suite.run("event.pass_overhead", param, suite.iterations(5000000), make_task(spin).size(), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            event_loop.runOnce(0);
+    });
+    suite.run("event.rebind", param, suite.iterations(2000000), size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            event_loop.bindEventHandler(handlers[249], onEvent, (int32_t)i);
+    });
+    suite.run("event.fire", param, suite.iterations(10000000), 0, [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            handlers[249]->exec();
+    });
+
+    event_loop.clearEventHandler(handlers[249]);
+    for(uint32_t i=0; i<bound; i++)
+        event_loop.clearEventHandler(handlers[i]);
+    spinning = false;
+    while(event_loop.hasPendingTasks())
+        event_loop.runOnce(0);
+}
+
+// a quarter of the ring in flight, every task requeues itself once, so the ring keeps wrapping around.
+// the task running still holds its bytes while it pushes the next one, and a wrap leaves the tail unused
+template<std::size_t taskbuf_size>
+struct WrapBench
+{
+    static EventLoop<taskbuf_size, 0> loop;
+    static uint64_t left;
+    static void hop(int64_t a, int64_t b)
+    {
+        executed++;
+        if(left)
+        {
+            left--;
+            loop.nextTick(hop, b, a);
+        }
+    }
+    static void run(bench::Suite& suite)
+    {
+        const std::size_t size = make_task(hop).setArgs({0, 0}).size();
+        const std::size_t inflight = taskbuf_size/size/4 ? taskbuf_size/size/4 : 1;
+        suite.run("queue.wrap_requeue", "taskbuf=" + std::to_string(taskbuf_size), suite.iterations(2000000), size,
+            [inflight](uint64_t ops){
+                left = ops > inflight ? ops-inflight : 0;
+                for(std::size_t i=0; i<inflight; i++)
+                    loop.nextTick(hop, (int64_t)i, (int64_t)i);
+                while(loop.hasPendingTasks())
+                    loop.runOnce(0);
+            });
+    }
+};
+template<std::size_t taskbuf_size>
+EventLoop<taskbuf_size, 0> WrapBench<taskbuf_size>::loop(&helper_functions);
+template<std::size_t taskbuf_size>
+uint64_t WrapBench<taskbuf_size>::left = 0;
+
+// watchdog churn: live timers in the queue (no resident slots) kicked over and over with no pass in between,
+// a kick cancels one and arms it again. ops is how many kicks fit before an allocation fails, capped at the
+// iteration count, so it is the effective capacity of the ring under churn. without reclaiming the tombstones
+// that is taskbuf/size kicks, whatever the live usage is
+static uint64_t churn_failures = 0;
+static EventLoopHelperFunctions churn_helper_functions{
+    nullptr, nullptr,
+    [](void*){ churn_failures++; },
+    nullptr,
+};
+static EventLoop<768, 0> churn_loop(&churn_helper_functions);
+static void watchdog() { executed++; }
+
+static void benchChurn(bench::Suite& suite, uint32_t live, bool set_first)
+{
+    TaskHandle dogs[8];
+    for(uint32_t i=0; i<live; i++)
+        dogs[i] = churn_loop.setTimeout(watchdog, 60000);
+    const uint64_t limit = suite.iterations(1000000);
+    uint64_t kicks = 0;
+    const uint64_t begin = bench::nowNs();
+    for(; kicks<limit && !churn_failures; kicks++)
+    {
+        TaskHandle& dog = dogs[kicks % live];
+        if(set_first)
+        {   // the new one is armed before the old one is gone, it is never the tail that dies, so only the sweep frees it
+            const TaskHandle next = churn_loop.setTimeout(watchdog, 60000);
+            churn_loop.clearTimeout(dog);
+            dog = next;
+        }
+        else
+        {
+            churn_loop.clearTimeout(dog);
+            dog = churn_loop.setTimeout(watchdog, 60000);
+        }
+    }
+    const uint64_t spent = bench::nowNs() - begin;
+    suite.record("churn.kicks_until_full", std::string("live=") + std::to_string(live) + (set_first ? ",set_first" : ",clear_first"),
+                 kicks, (double)spent/kicks, make_task(watchdog).transform<TimeoutTask>().size());
+
+    for(uint32_t i=0; i<live; i++)
+        churn_loop.clearTimeout(dogs[i]);
+    while(churn_loop.hasPendingTasks())
+        churn_loop.runOnce(0);
+    churn_failures = 0;
+}
+
+// a firmware-like mix of periodic timers armed at scattered times, run for a simulated minute by a loop that sleeps
+// until nextDeadline() like run() does. ops is how many passes, i.e. wakeups, the minute takes, ns/op the cost of one
+struct PeriodicTimer
+{
+    uint16_t period;
+    uint16_t slack;
+};
+static constexpr PeriodicTimer timer_mix[] = {
+    {20, 0},                                // key scan, needs its precision
+    {500, 50}, {500, 50}, {333, 50},        // led blinks
+    {250, 25}, {100, 10}, {1000, 100},      // telemetry
+    {1000, 250}, {2000, 250}, {5000, 500},  // housekeeping
+};
+static EventLoop<768, 16> coalesce_loop(&helper_functions);
+static void tick() { executed++; }
+
+static void benchCoalescing(bench::Suite& suite, bool slack, bool key_scan)
+{
+    uint32_t seed = 777;
+    for(const auto& t : timer_mix)
+    {
+        if(!key_scan && !t.slack)
+            continue;
+        seed = seed*1103515245 + 12345;
+        coalesce_loop.runOnce((seed>>8)%97);    // armed at different times, as they would be in a firmware
+        if(slack)
+            coalesce_loop.setInterval(tick, t.period, TimerSlack(t.slack));
+        else
+            coalesce_loop.setInterval(tick, t.period);
+    }
+    const uint64_t fired = executed;
+    uint64_t wakeups = 0;
+    const uint64_t begin = bench::nowNs();
+    for(uint32_t now=0; now<60000; wakeups++)
+    {
+        const uint32_t left = coalesce_loop.nextDeadline();
+        now += left;
+        coalesce_loop.runOnce(left);
+    }
+    const uint64_t spent = bench::nowNs() - begin;
+    suite.record("timers.wakeups_per_minute", std::string(slack ? "slack=on" : "slack=off") + (key_scan ? ",key_scan" : ""),
+                 wakeups, (double)spent/wakeups, 0);
+    fprintf(stderr, "bench: %llu timers fired in the minute\n", (unsigned long long)(executed-fired));
+    coalesce_loop.clearInterval(tick);
+}
+
+// timers that clear themselves while they run, by the function pointer, by the handle, and both.
+// the slot of the running one is freed once, after it returns, and it can no longer be found
+static EventLoop<256, 8> self_loop;
+static TaskHandle self_handle;
+static uint32_t self_runs = 0;
+static bool self_found = false;
+static void selfByFunction()
+{
+    if(++self_runs < 20)
+        return;
+    self_loop.clearInterval(selfByFunction);
+    self_found = self_found || self_loop.findInterval(selfByFunction) || self_loop.findInterval(self_handle);
+}
+static void selfByBoth()
+{
+    if(++self_runs < 20)
+        return;
+    self_loop.clearInterval(self_handle);
+    self_loop.clearInterval(selfByBoth);
+    self_loop.clearInterval(self_handle);
+    self_found = self_found || self_loop.findInterval(selfByBoth) || self_loop.findInterval(self_handle);
+}
+static void selfTimeout()
+{
+    self_runs++;
+    self_loop.clearTimeout(self_handle);
+    self_loop.clearTimeout(selfTimeout);    // clears the other one armed with it too
+    self_found = self_found || self_loop.findTimeout(selfTimeout) || self_loop.findTimeout(self_handle);
+}
+
+static bool selfClearOnce(void (*callback)(), bool interval, uint32_t armed, uint32_t runs)
+{
+    self_runs = 0;
+    self_found = false;
+    for(uint32_t i=0; i<armed; i++)
+        self_handle = interval ? self_loop.setInterval(callback, 1) : self_loop.setTimeout(callback, 1+i);
+    for(uint32_t i=0; i<100; i++)
+        self_loop.runOnce(1);
+    return self_runs == runs && !self_found && self_loop.__debugGetResidentPool()->used() == 0;
+}
+
+static bool selfClearCounts()
+{
+    return selfClearOnce(selfByFunction, true, 1, 20)
+        && selfClearOnce(selfByBoth, true, 1, 20)
+        && selfClearOnce(selfByFunction, true, 2, 20)   // both due in the same pass, the second is cleared before it runs
+        && selfClearOnce(selfTimeout, false, 2, 1);
+}
+
+// an event handler unbinding itself and binding another one while it runs: its captures are read after that,
+// so its slot must not have been handed to the new handler yet. Bytes of captures puts it in the queue or a slot
+static TaskInterface* self_event = nullptr;
+static TaskInterface* self_next = nullptr;
+template<std::size_t Bytes>
+static bool selfUnbindOnce()
+{
+    struct Padded { uint32_t tag; char pad[Bytes]; } padded{7, {0}};
+    self_runs = 0;
+    self_loop.bindEventHandler(self_event, make_task([padded]() {
+        self_loop.clearEventHandler(self_event);
+        const uint32_t other = 1000;
+        self_loop.bindEventHandler(self_next, make_task([other]() { self_runs += other; }));
+        self_runs += padded.tag;
+    }));
+    TaskInterface* const fired = self_event;
+    fired->exec();
+    self_next->exec();
+    const bool unbound = self_event == nullptr && self_runs == 1007;
+    self_loop.clearEventHandler(self_next);
+    for(uint32_t i=0; i<2; i++)
+        self_loop.runOnce(1);
+    return unbound && self_loop.__debugGetResidentPool()->used() == 0 && self_loop.__debugGetTaskQueue()->getLength() == 0;
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    if(!selfClearCounts())
+    {
+        fprintf(stderr, "bench: timers clearing themselves ran %u times or were not freed once, the results are not comparable\n", self_runs);
+        return 1;
+    }
+    if(!selfUnbindOnce<4>() || !selfUnbindOnce<128>())
+    {
+        fprintf(stderr, "bench: an event handler unbinding itself ran %u times or was not freed, the results are not comparable\n", self_runs);
+        return 1;
+    }
+
+    benchNextTick(suite, task0);
+    benchNextTick(suite, task16, 1, 2);
+    benchNextTick(suite, task32, 1, 2, 3, 4);
+    benchNextTick(suite, task64, 1, 2, 3, 4, 5, 6, 7, 8);
+
+    for(uint32_t armed : {0, 16, 64, 240})
+        benchTimers(suite, armed);
+
+    for(uint32_t bound : {0, 8, 64, 200})
+        benchEvents(suite, bound);
+
+    WrapBench<160>::run(suite);
+    WrapBench<256>::run(suite);
+    WrapBench<768>::run(suite);
+    WrapBench<4096>::run(suite);
+
+    for(uint32_t live : {1, 4, 8})
+    {
+        benchChurn(suite, live, false);
+        benchChurn(suite, live, true);
+    }
+
+    for(bool key_scan : {false, true})
+    {
+        benchCoalescing(suite, false, key_scan);
+        benchCoalescing(suite, true, key_scan);
+    }
+
+    bench::doNotOptimize(executed);
+    if(failures)
+    {
+        fprintf(stderr, "bench: %llu task allocations failed, the results are not comparable\n", (unsigned long long)failures);
+        return 1;
+    }
+    return suite.finish();
+}
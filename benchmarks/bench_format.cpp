@@ -0,0 +1,297 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    Number formatting of PipeIO: ns per formatted number through a PipeIO into memory, with the digit loop PipeIO had
+    before (a division and a modulo per digit, 64bit ones for int64_t, float multiplied per decimal and truncated) and snprintf()
+    as references.
+    Before measuring, Format.h is checked against snprintf(): every int32_t magnitude below 2^20 and a stride through
+    the rest of the 32bit range, signed and unsigned, radix 10, 16 and 8 with and without width, zero padding and
+    prefix, binary read back by strtoull(), int64_t at every power of ten and random ones, decimal and Q16.16/Q8.8 fixed
+    point over all their decimals, and quarters as floats. Any mismatch fails the process.
+*/
+
+int64_t Time::s_offset = 0;
+
+static char out[64];
+static uint8_t out_length = 0;
+static void toMemory(char c) { out[out_length++ & 63] = c; }
+static PipeIO<toMemory> io(nullptr, 0);
+
+struct Buffer
+{
+    char text[128];
+    uint8_t length = 0;
+    void operator()(char c) { text[length++] = c; }
+    std::string str() const { return std::string(text, length); }
+};
+
+static uint64_t mismatches = 0;
+
+static void expect(const std::string& got, const char* want, const char* what)
+{
+    if(got != want && mismatches++ < 8)
+        fprintf(stderr, "bench_format: %s gives \"%s\", snprintf \"%s\"\n", what, got.c_str(), want);
+}
+
+template<typename T>
+static std::string format(T value, const NumberFormat& format)
+{
+    Buffer b;
+    formatInteger(b, value, format);
+    return b.str();
+}
+
+static void checkInt32(int32_t v)
+{
+    char want[48];
+    snprintf(want, sizeof(want), "%ld", (long)v);
+    expect(format(v, NumberFormat()), want, "int32");
+    snprintf(want, sizeof(want), "%lu", (unsigned long)(uint32_t)v);
+    expect(format((uint32_t)v, NumberFormat()), want, "uint32");
+    snprintf(want, sizeof(want), "%lX", (unsigned long)(uint32_t)v);
+    expect(format((uint32_t)v, NumberFormat(16)), want, "uint32 hex");
+    snprintf(want, sizeof(want), "%lo", (unsigned long)(uint32_t)v);
+    expect(format((uint32_t)v, NumberFormat(8)), want, "uint32 oct");
+    if(v % 61)
+        return;
+    const uint8_t width = (uint32_t)v % 19;
+    snprintf(want, sizeof(want), "%0*ld", width, (long)v);
+    expect(format(v, NumberFormat::dec(width, '0')), want, "int32 zero padded");
+    snprintf(want, sizeof(want), "%*ld", width, (long)v);
+    expect(format(v, NumberFormat::dec(width)), want, "int32 space padded");
+    snprintf(want, sizeof(want), "%#0*lo", width, (unsigned long)(uint32_t)v);
+    expect(format((uint32_t)v, NumberFormat(8, width, '0', true)), want, "uint32 oct prefixed");
+    if(v)
+    {
+        snprintf(want, sizeof(want), "%#0*lx", width, (unsigned long)(uint32_t)v);
+        for(char* p = want; *p; p++)
+            if(*p != 'x')
+                *p = toupper(*p);
+        expect(format((uint32_t)v, NumberFormat::hex(width)), want, "uint32 hex prefixed");
+    }
+    const std::string bin = format((uint32_t)v, NumberFormat::bin());
+    if(bin.compare(0, 2, "0b") || strtoull(bin.c_str()+2, nullptr, 2) != (uint32_t)v)
+        expect(bin, "binary read back", "uint32 bin");
+}
+
+static void checkInt64(int64_t v)
+{
+    char want[48];
+    snprintf(want, sizeof(want), "%lld", (long long)v);
+    expect(format(v, NumberFormat()), want, "int64");
+    snprintf(want, sizeof(want), "%llu", (unsigned long long)v);
+    expect(format((uint64_t)v, NumberFormat()), want, "uint64");
+    snprintf(want, sizeof(want), "%llX", (unsigned long long)v);
+    expect(format((uint64_t)v, NumberFormat(16)), want, "uint64 hex");
+    snprintf(want, sizeof(want), "%028lld", (long long)v);
+    expect(format(v, NumberFormat::dec(28, '0')), want, "int64 zero padded");
+    const std::string bin = format((uint64_t)v, NumberFormat(2));
+    if(strtoull(bin.c_str(), nullptr, 2) != (uint64_t)v)
+        expect(bin, "binary read back", "uint64 bin");
+}
+
+static void checkDecimal(int32_t scaled, uint8_t decimals)
+{
+    const uint64_t m = scaled < 0 ? -(int64_t)scaled : scaled;
+    uint64_t power = 1;
+    for(uint8_t i=0; i<decimals; i++)
+        power *= 10;
+    char want[300];
+    if(decimals)
+        snprintf(want, sizeof(want), "%s%llu.%0*llu", scaled < 0 ? "-" : "", (unsigned long long)(m/power),
+                 decimals, (unsigned long long)(m%power));
+    else
+        snprintf(want, sizeof(want), "%ld", (long)scaled);
+    Buffer b;
+    formatDecimal(b, scaled, decimals);
+    expect(b.str(), want, "decimal");
+}
+
+static void checkFixed(int32_t q, uint8_t frac_bits, uint8_t decimals)
+{
+    char want[48];
+    snprintf(want, sizeof(want), "%.*f", decimals, (double)q/(1 << frac_bits));
+    Buffer b;
+    formatFixed(b, q, frac_bits, decimals);
+    expect(b.str(), want, "fixed");
+}
+
+// floats that are exact in their decimals, the one multiplication of formatFloat() must not be off
+static void checkFloat(float f, uint8_t decimals)
+{
+    char want[48];
+    snprintf(want, sizeof(want), "%.*f", decimals, (double)f);
+    Buffer b;
+    formatFloat(b, f, decimals);
+    expect(b.str(), want, "float");
+}
+
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+static uint64_t random64()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+// random magnitudes: as many short numbers as long ones
+static uint64_t randomNumber(uint8_t bits)
+{
+    return random64() >> (64 - 1 - random64() % bits);
+}
+
+static void crossCheck(bool quick)
+{
+    for(int32_t v=0; v < (1 << 20); v++)
+    {
+        checkInt32(v);
+        checkInt32(-v);
+    }
+    const uint32_t stride = quick ? 99991 : 997;
+    for(uint64_t v=1 << 20; v <= 0xFFFFFFFF; v += stride)
+        checkInt32((int32_t)v);
+    checkInt32(INT32_MIN);
+    checkInt32(INT32_MAX);
+
+    uint64_t power = 1;
+    for(uint8_t i=0; i<20; i++, power *= 10)
+        for(int64_t d : {-1, 0, 1})
+        {
+            checkInt64(power + d);
+            checkInt64(-(int64_t)(power + d));
+        }
+    checkInt64(INT64_MIN);
+    checkInt64(INT64_MAX);
+    for(uint32_t i=0; i < (quick ? 10000u : 1000000u); i++)
+        checkInt64(randomNumber(64));
+
+    for(uint8_t decimals=0; decimals<=9; decimals++)
+        for(uint32_t i=0; i < (quick ? 2000u : 200000u); i++)
+            checkDecimal((int32_t)randomNumber(32), decimals);
+    for(uint8_t decimals=0; decimals<=4; decimals++)
+    {
+        for(int32_t q=INT16_MIN; q<=INT16_MAX; q++)
+            checkFixed(q, 8, decimals);
+        for(uint64_t q=0; q <= 0xFFFFFFFF; q += quick ? 99991 : 4093)
+            checkFixed((int32_t)q, 16, decimals);
+    }
+    for(int32_t k=-400000; k<=400000; k++)
+        for(uint8_t decimals=2; decimals<=4; decimals++)
+            checkFloat(k/4.0f, decimals);
+}
+
+// PipeIO::sendInt32/sendInt64/sendFloat before Format.h, decimal only. the radix was chosen at run time
+static volatile bool hex = false;
+template<typename T>
+static void digitLoop(T number)
+{
+    const uint8_t radix = hex ? 16 : 10;
+    if(number < 0)
+    {
+        io.sendByte('-');
+        number = -number;
+    }
+    char buffer[24] = {0};
+    char *ptr = buffer + sizeof(buffer) - 1;
+    do
+    {
+        *--ptr = "0123456789ABCDEF"[number % radix];
+        number /= 10;
+    } while(number);
+    io.sendString(ptr);
+}
+static void floatLoop(float number, uint8_t decimals)
+{
+    digitLoop((int32_t)number);
+    int32_t tens = 1;
+    number = number<0? -number:number;
+    for(int i=0; i<decimals; i++)
+    {
+        tens *= 10;
+        number *= 10;
+    }
+    io.sendByte('.');
+    digitLoop((int32_t)number%tens);
+}
+
+static int32_t int32s[4096];
+static int64_t int64s[4096];
+static float floats[4096];
+
+static void benchFormat(bench::Suite& suite)
+{
+    for(uint32_t i=0; i<4096; i++)
+    {
+        int32s[i] = (int32_t)randomNumber(32);
+        int64s[i] = (int64_t)randomNumber(64);
+        floats[i] = (float)(int32_t)randomNumber(24)/1000;
+    }
+    const uint64_t ops = suite.iterations(4000000);
+    char text[48];
+
+    suite.run("format.int32", "with=digit_loop", ops, sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            digitLoop(int32s[i & 4095]);
+    });
+    suite.run("format.int32", "with=Format.h", ops, sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            io << int32s[i & 4095];
+    });
+    suite.run("format.int32", "with=snprintf", ops, sizeof(int32_t), [&text](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            out_length += snprintf(text, sizeof(text), "%ld", (long)int32s[i & 4095]);
+    });
+    suite.run("format.int64", "with=digit_loop", ops, sizeof(int64_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            digitLoop(int64s[i & 4095]);
+    });
+    suite.run("format.int64", "with=Format.h", ops, sizeof(int64_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            io << int64s[i & 4095];
+    });
+    suite.run("format.int64", "with=snprintf", ops, sizeof(int64_t), [&text](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            out_length += snprintf(text, sizeof(text), "%lld", (long long)int64s[i & 4095]);
+    });
+    suite.run("format.hex32", "with=Format.h", ops, sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            io.sendUInt32(int32s[i & 4095], NumberFormat::hex(8));
+    });
+    suite.run("format.float", "with=digit_loop", ops, sizeof(float), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            floatLoop(floats[i & 4095], 2);
+    });
+    suite.run("format.float", "with=Format.h", ops, sizeof(float), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            io.sendFloat(floats[i & 4095], 2);
+    });
+    suite.run("format.fixed_q16", "with=Format.h", ops, sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            io.sendFixed(int32s[i & 4095], 16, 3);
+    });
+    suite.run("format.fixed_q16", "with=snprintf", ops, sizeof(int32_t), [&text](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            out_length += snprintf(text, sizeof(text), "%.3f", (double)int32s[i & 4095]/65536);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+
+    crossCheck(suite.quick());
+    if(mismatches)
+    {
+        fprintf(stderr, "bench_format: %llu mismatches, the results are not comparable\n", (unsigned long long)mismatches);
+        return 1;
+    }
+    benchFormat(suite);
+
+    bench::doNotOptimize(out);
+    return suite.finish();
+}
@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "../include/EventLoopHost.h"
+#include "../include/Framing.h"
+#include "bench.h"
+
+/*
+    Throughput of Framing.h: a CRC over 1KB in every kernel, the bitwise one being what a hand rolled
+    byte at a time checksum does, then frames of 64 and 1000 bytes encoded into memory by writeFrame() and
+    FrameWriter, and decoded by FrameDecoder from a stream of them, with Cobs and Slip over a Crc32.
+    Payloads are random bytes, which Slip escapes 1 in 128 of, and "sparse" ones, mostly 0s as in telemetry structs.
+    Before measuring, every kernel must give the check values of CRC-16/X-25 and CRC-32 and agree on random
+    lengths and alignments, and every frame must decode back to its payload, or the process fails.
+*/
+
+int64_t Time::s_offset = 0;
+
+struct Memory
+{
+    std::vector<uint8_t> bytes;
+    void operator()(char c) { bytes.push_back((uint8_t)c); }
+};
+
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+static uint64_t random64()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static std::vector<uint8_t> payload(std::size_t length, bool sparse)
+{
+    std::vector<uint8_t> bytes(length);
+    for(auto& b : bytes)
+        b = sparse && random64() % 4 ? 0 : (uint8_t)random64();
+    return bytes;
+}
+
+template<template<CrcKernel> class C>
+static bool kernelsAgree(uint32_t check)
+{
+    bool ok = C<CrcKernel::BITWISE>::of("123456789", 9) == check;
+    ok &= C<CrcKernel::NIBBLE>::of("123456789", 9) == check;
+    ok &= C<CrcKernel::TABLE>::of("123456789", 9) == check;
+    ok &= C<CrcKernel::SLICE4>::of("123456789", 9) == check;
+    ok &= C<CrcKernel::SLICE8>::of("123456789", 9) == check;
+    const std::vector<uint8_t> bytes = payload(4096, false);
+    for(int i=0; i<1000; i++)
+    {
+        const std::size_t offset = random64() % 64, length = random64() % 4000;
+        const auto want = C<CrcKernel::BITWISE>::of(&bytes[offset], length);
+        ok &= C<CrcKernel::NIBBLE>::of(&bytes[offset], length) == want;
+        ok &= C<CrcKernel::TABLE>::of(&bytes[offset], length) == want;
+        ok &= C<CrcKernel::SLICE4>::of(&bytes[offset], length) == want;
+        ok &= C<CrcKernel::SLICE8>::of(&bytes[offset], length) == want;
+    }
+    return ok;
+}
+
+static uint64_t sink = 0;
+
+template<class C>
+static void benchCrc(bench::Suite& suite, const char* name, const char* kernel, const std::vector<uint8_t>& bytes)
+{
+    const uint64_t ops = suite.iterations(20000);
+    suite.run(name, kernel, ops, bytes.size(), [&bytes](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += C::of(bytes.data(), bytes.size());
+    });
+}
+
+static void benchCrcs(bench::Suite& suite)
+{
+    const std::vector<uint8_t> bytes = payload(1024, false);
+    benchCrc<Crc16<CrcKernel::BITWISE>>(suite, "crc16", "kernel=bitwise", bytes);
+    benchCrc<Crc16<CrcKernel::NIBBLE>>(suite, "crc16", "kernel=nibble", bytes);
+    benchCrc<Crc16<CrcKernel::TABLE>>(suite, "crc16", "kernel=table", bytes);
+    benchCrc<Crc16<CrcKernel::SLICE4>>(suite, "crc16", "kernel=slice4", bytes);
+    benchCrc<Crc16<CrcKernel::SLICE8>>(suite, "crc16", "kernel=slice8", bytes);
+    benchCrc<Crc32<CrcKernel::BITWISE>>(suite, "crc32", "kernel=bitwise", bytes);
+    benchCrc<Crc32<CrcKernel::NIBBLE>>(suite, "crc32", "kernel=nibble", bytes);
+    benchCrc<Crc32<CrcKernel::TABLE>>(suite, "crc32", "kernel=table", bytes);
+    benchCrc<Crc32<CrcKernel::SLICE4>>(suite, "crc32", "kernel=slice4", bytes);
+    benchCrc<Crc32<CrcKernel::SLICE8>>(suite, "crc32", "kernel=slice8", bytes);
+}
+
+// the sink a uart would be, bytes into a fixed buffer
+static uint8_t wire[4096];
+static uint16_t wire_length = 0;
+static void toWire(char c) { wire[wire_length++ & 4095] = c; }
+
+static uint64_t decoded_frames, decoded_bytes;
+
+template<class Codec>
+static bool benchCodec(bench::Suite& suite, const char* codec, std::size_t length, bool sparse)
+{
+    using Crc = Crc32<>;
+    using Decoder = FrameDecoder<Codec, Crc, Codec::encodedLength(1004)>;
+    const uint64_t ops = suite.iterations(length < 100 ? 200000 : 20000);
+    const std::vector<uint8_t> bytes = payload(length, sparse);
+    char param[64];
+    snprintf(param, sizeof(param), "codec=%s,payload=%zu,data=%s", codec, length, sparse ? "sparse" : "random");
+    auto toWireSink = toWire;
+
+    suite.run("frame.encode", std::string(param) + ",with=writeFrame", ops, length, [&](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            writeFrame<Codec, Crc>(toWireSink, bytes.data(), bytes.size());
+    });
+    suite.run("frame.encode", std::string(param) + ",with=FrameWriter", ops, length, [&](uint64_t ops){
+        FrameWriter<Codec, Crc, decltype(toWireSink)> writer(toWireSink);
+        for(uint64_t i=0; i<ops; i++)
+        {
+            writer.write(bytes.data(), bytes.size());
+            writer.end();
+        }
+    });
+
+    // 64 frames back to back, as a uart would hand them over
+    Memory stream;
+    for(int i=0; i<64; i++)
+        writeFrame<Codec, Crc>(stream, bytes.data(), bytes.size());
+    static Decoder decoder;
+    static const std::vector<uint8_t>* want;
+    static bool same;
+    want = &bytes;
+    same = true;
+    decoded_frames = decoded_bytes = 0;
+    decoder.onFrame = [](Decoder*, const uint8_t* payload, uint16_t length){
+        same &= length == want->size() && memcmp(payload, want->data(), length) == 0;
+        decoded_frames++;
+        decoded_bytes += length;
+    };
+    const uint16_t errors = decoder.errors();
+    suite.run("frame.decode", param, ops, length, [&](uint64_t ops){
+        for(uint64_t i=0; i<ops; i += 64)
+            decoder.receive(stream.bytes.data(), stream.bytes.size());
+    });
+    return same && decoded_frames && decoded_bytes == decoded_frames*length && decoder.errors() == errors;
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+
+    if(!kernelsAgree<Crc16>(0x906E) || !kernelsAgree<Crc32>(0xCBF43926))
+    {
+        fprintf(stderr, "bench_framing: the CRC kernels disagree, the results are not comparable\n");
+        return 1;
+    }
+    benchCrcs(suite);
+    bool ok = true;
+    for(std::size_t length : {64, 1000})
+        for(bool sparse : {false, true})
+        {
+            ok &= benchCodec<Cobs>(suite, "cobs", length, sparse);
+            ok &= benchCodec<Slip>(suite, "slip", length, sparse);
+        }
+    if(!ok)
+    {
+        fprintf(stderr, "bench_framing: frames did not decode back to their payload, the results are not comparable\n");
+        return 1;
+    }
+
+    bench::doNotOptimize(sink);
+    bench::doNotOptimize(wire);
+    return suite.finish();
+}
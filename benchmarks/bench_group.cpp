@@ -0,0 +1,91 @@
+#include <atomic>
+#include "../include/EventLoopHost.h"
+#include "../include/EventLoopGroup.h"
+#include "bench.h"
+
+/*
+    Throughput of EventLoopGroup from 1 to N shards: tokens hop from key to key, every hop does a bit of work
+    on the shard of its key and sends the token on, most hops cross to another shard through a mailbox.
+    ns/op is wall time per hop, so it drops as shards are added, as long as there are cores to run them.
+*/
+
+int64_t Time::s_offset = 0;
+
+static constexpr uint32_t tokens = 48;      // fewer than the mail slots, a mailbox never fills
+static constexpr uint32_t keys = 1024;
+static std::atomic<uint64_t> hops_left;
+static std::atomic<uint64_t> failures;
+
+static EventLoopHelperFunctions helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },
+    sleepUntilInterrupt,
+};
+
+// some cpu time per message, what a handler of a gateway would spend
+static uint32_t work(uint32_t x, uint32_t rounds)
+{
+    for(uint32_t i=0; i<rounds; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+    }
+    return x;
+}
+
+template<std::size_t shards>
+struct GroupBench
+{
+    using Group = EventLoopGroup<shards, EventLoop<4096, 0>, 64>;
+    static Group* group;
+
+    static void hop(uint32_t key, uint32_t rounds)
+    {
+        const uint32_t x = work(key, rounds);
+        if(hops_left.fetch_sub(1, std::memory_order_relaxed) > 1)
+        {
+            if(!group->post((x ^ key) % keys, hop, (x ^ key) % keys, rounds))
+                failures++;
+        }
+        else
+            group->stop();
+    }
+    static void run(bench::Suite& suite, uint32_t rounds)
+    {
+        const uint64_t hops = suite.iterations(400000);
+        suite.run("group.hop", "shards=" + std::to_string(shards) + ",work=" + std::to_string(rounds), hops, 0,
+            [rounds](uint64_t ops){
+                group = new Group(&helper_functions);
+                hops_left = ops;    // hop() stops the group on the last one, the other tokens die with it
+                for(uint32_t t=0; t<tokens; t++)
+                    group->post(t*(keys/tokens), hop, t*(keys/tokens), rounds);
+                group->start();
+                group->join();
+                delete group;
+            });
+    }
+};
+template<std::size_t shards>
+typename GroupBench<shards>::Group* GroupBench<shards>::group = nullptr;
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    fprintf(stderr, "bench_group: %u hardware threads\n", std::thread::hardware_concurrency());
+
+    for(uint32_t rounds : {0, 64, 512})
+    {
+        GroupBench<1>::run(suite, rounds);
+        GroupBench<2>::run(suite, rounds);
+        GroupBench<4>::run(suite, rounds);
+        GroupBench<8>::run(suite, rounds);
+    }
+
+    if(failures)
+    {
+        fprintf(stderr, "bench: %llu posts or allocations failed, the results are not comparable\n", (unsigned long long)failures.load());
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    post() to exec latency: a producer thread, standing in for an ISR, stamps platformMicros() into the task it posts,
+    the task records exec - stamp when the loop runs it. The posts are spaced out, so the loop is between passes
+    or asleep when one arrives. Reported as p50/p99/max in ns/op, ops is the number of samples, with the loop
+    spinning on runOnce() and with the idle hook sleeping until wakeup(). A dropped post fails the process.
+*/
+
+int64_t Time::s_offset = 0;
+
+using Loop = EventLoop<1024, 4, 8*sizeof(void*), 4, 64>;
+
+static uint64_t failures = 0;
+
+static EventLoopHelperFunctions spinning_helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },
+    nullptr,
+};
+static EventLoopHelperFunctions sleeping_helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },
+    sleepUntilInterrupt,
+};
+static Loop spinning_loop(&spinning_helper_functions);
+static Loop sleeping_loop(&sleeping_helper_functions);
+
+static Loop* loop = nullptr;
+static std::vector<uint32_t> latencies;
+static uint32_t samples = 0;
+
+static void keepAlive() {}      // run() returns on an empty loop, this keeps it waiting for the posts
+static void onPosted(uint64_t stamp)
+{
+    latencies.push_back((uint32_t)(platformMicros() - stamp));
+    if(latencies.size() == samples)
+        loop->clearInterval(keepAlive);
+}
+
+static void benchLatency(bench::Suite& suite, Loop& target, const char* param)
+{
+    loop = &target;
+    samples = suite.iterations(5000) < 200 ? 200 : suite.iterations(5000);
+    latencies.clear();
+    latencies.reserve(samples);
+
+    loop->setInterval(keepAlive, 1000);
+    std::thread producer([]{
+        uint32_t seed = 4242;
+        for(uint32_t i=0; i<samples; i++)
+        {   // 100 to 400 us apart, an idle loop has long gone back to sleep by then
+            seed = seed*1103515245 + 12345;
+            std::this_thread::sleep_for(std::chrono::microseconds(100 + (seed>>8)%300));
+            if(!loop->post(onPosted, platformMicros()))
+                failures++;
+        }
+    });
+    loop->run();
+    producer.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    const double us = 1000;
+    suite.record("post.exec_latency", std::string(param) + ",stat=p50", latencies.size(), latencies[latencies.size()/2]*us, 0);
+    suite.record("post.exec_latency", std::string(param) + ",stat=p99", latencies.size(), latencies[latencies.size()*99/100]*us, 0);
+    suite.record("post.exec_latency", std::string(param) + ",stat=max", latencies.size(), latencies.back()*us, 0);
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    fprintf(stderr, "bench_inject: %u hardware threads, on one the spinning loop takes the cpu from the producer\n",
+            std::thread::hardware_concurrency());
+
+    benchLatency(suite, spinning_loop, "idle=none");
+    benchLatency(suite, sleeping_loop, "idle=sleepUntilInterrupt");
+
+    if(failures || spinning_loop.droppedPosts() || sleeping_loop.droppedPosts())
+    {
+        fprintf(stderr, "bench: %llu posts or allocations failed, the results are not comparable\n",
+                (unsigned long long)(failures + spinning_loop.droppedPosts() + sleeping_loop.droppedPosts()));
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "../include/EventLoopHost.h"
+#include "../include/Log.h"
+#include "bench.h"
+
+/*
+    Log.h against printing the same line with operator<<: ns per line through a PipeIO into memory and the bytes
+    it puts on the wire, B/op here. log.wire_time is how long those bytes take on a uart at 9600 baud, 10 bits a byte.
+    The lines: a float reading, three integers, and a state name with a float. A string is copied into the record
+    and again by COBS where operator<< hands it straight over, so on a host that line costs more cpu, not more bytes.
+    Before measuring, every LOG_* record must COBS-decode to the id log_impl::id() gives its format and to
+    the arguments it was given, or the process fails.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint8_t wire[256];
+static uint64_t wire_bytes = 0;
+static void toWire(char c) { wire[wire_bytes++ & 255] = c; }
+static PipeIO<toWire> io(nullptr, 0);
+
+static volatile float temperature = 23.5f;
+static volatile uint16_t adc = 611;
+static volatile int32_t offset = -1234;
+static volatile uint32_t uptime = 86400;
+static const char* volatile state = "charging";
+
+static void printFloat() { io << "temp=" << (float)temperature << "\r\n"; }
+static void logFloat() { LOG_INFO("temp=%f\r\n", (float)temperature); }
+static void printInts() { io << "adc=" << (uint16_t)adc << " offset=" << (int32_t)offset << " uptime=" << (uint32_t)uptime << "\r\n"; }
+static void logInts() { LOG_INFO("adc=%u offset=%d uptime=%u\r\n", (uint16_t)adc, (int32_t)offset, (uint32_t)uptime); }
+static void printString() { io << "state " << (const char*)state << " at " << (float)temperature << "\r\n"; }
+static void logString() { LOG_INFO("state %s at %f\r\n", (const char*)state, (float)temperature); }
+
+static void benchLine(bench::Suite& suite, const char* name, const char* param, void (*line)())
+{
+    const uint64_t ops = suite.iterations(1000000);
+    const uint64_t before = wire_bytes;
+    line();
+    const double bytes = wire_bytes - before;
+    suite.run("log.line", std::string(param) + ",with=" + name, ops, bytes, [line](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            line();
+    });
+    suite.record("log.wire_time", std::string(param) + ",with=" + name + ",baud=9600", 1, bytes * 10 / 9600 * 1e9, bytes);
+}
+
+// the last record on the wire, COBS decoded
+static bool lastRecord(uint8_t* record, uint16_t& length)
+{
+    const uint64_t end = wire_bytes - 1;
+    if(wire[end & 255] != Cobs::delimiter)
+        return false;
+    uint64_t begin = end;
+    while(begin > 0 && end - begin < 255 && wire[(begin-1) & 255] != Cobs::delimiter)
+        begin--;
+    length = end - begin;
+    for(uint16_t i=0; i<length; i++)
+        record[i] = wire[(begin+i) & 255];
+    return Cobs::decode(record, length);
+}
+
+static bool expect(void (*line)(), uint16_t id, const uint8_t* args, uint16_t args_length)
+{
+    uint8_t record[256];
+    uint16_t length;
+    line();
+    return lastRecord(record, length) && length == args_length + 2 && (record[0] | record[1] << 8) == id
+        && memcmp(record + 2, args, args_length) == 0;
+}
+
+static bool recordsDecode()
+{
+    // 23.5f is 0x41BC0000, 611 zigzags to 1222, -1234 to 2467, 86400 to 172800
+    const uint8_t float_args[] = { 0x00, 0x00, 0xBC, 0x41 };
+    const uint8_t int_args[] = { 0xC6, 0x09, 0xA3, 0x13, 0x80, 0xC6, 0x0A };
+    const uint8_t string_args[] = { 8, 'c', 'h', 'a', 'r', 'g', 'i', 'n', 'g', 0x00, 0x00, 0xBC, 0x41 };
+    return expect(logFloat, log_impl::id(LOG_LEVEL_INFO, "temp=%f\r\n"), float_args, sizeof(float_args))
+        && expect(logInts, log_impl::id(LOG_LEVEL_INFO, "adc=%u offset=%d uptime=%u\r\n"), int_args, sizeof(int_args))
+        && expect(logString, log_impl::id(LOG_LEVEL_INFO, "state %s at %f\r\n"), string_args, sizeof(string_args))
+        && Log::dropped() == 0;
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    Log::to(io);
+
+    if(!recordsDecode())
+    {
+        fprintf(stderr, "bench_log: the records do not decode to their ids and arguments, the results are not comparable\n");
+        return 1;
+    }
+    benchLine(suite, "operator<<", "args=float", printFloat);
+    benchLine(suite, "LOG_INFO", "args=float", logFloat);
+    benchLine(suite, "operator<<", "args=3ints", printInts);
+    benchLine(suite, "LOG_INFO", "args=3ints", logInts);
+    benchLine(suite, "operator<<", "args=string+float", printString);
+    benchLine(suite, "LOG_INFO", "args=string+float", logString);
+
+    bench::doNotOptimize(wire);
+    return suite.finish();
+}
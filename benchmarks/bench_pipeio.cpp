@@ -0,0 +1,293 @@
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    How long writing to a uart stalls the loop, through a SimulatedUart at 115200 baud (86.8us a byte) into a pipe.
+    A writer interval prints a 38 byte status line every 5ms while a sampler interval runs every 1ms:
+    write_stall is the time the write statement takes, interval_late_max how far the sampler falls behind.
+    PipeIO<Func> waits for every byte on the wire, PipeIO<Func, 64> copies the line into its ring and returns,
+    the TX complete "ISR" of the wire thread sends the rest. Every byte must come out of the pipe and none may be
+    dropped, or the process fails.
+    Receiving: the same lines byte by byte through receive() with a loop pass after each, as an RX ISR between passes
+    would. frameLines() posts onData once a line, frameNone() once a byte. Every line must arrive whole.
+    Bulk writes: buffers of 64 and 1024 bytes through write(), byte by byte into Func or whole into a bulk sender,
+    into /dev/null (a write(2) a byte or one for all) and into memory, where the difference is the call per byte.
+    With a 128 byte TX ring the drain is a TX "ISR" per byte or a "DMA" transfer per run, and a message written as
+    sendByte() a byte at a time, as write(), or as writev() of a header, the payload and a checksum.
+    Everything written into memory must come out in order, or the process fails.
+*/
+
+int64_t Time::s_offset = 0;
+
+static int wire_pipe[2];
+static int openWire()
+{
+    if(pipe(wire_pipe) < 0)
+        return -1;
+    return wire_pipe[1];
+}
+static SimulatedUart wire(openWire(), 115200);
+static char rx_buffer[8];
+static PipeIO<simulatedSendByte<wire>> blocking(rx_buffer, sizeof(rx_buffer));
+static PipeIO<simulatedSendByte<wire>, 64> async(rx_buffer, sizeof(rx_buffer));
+
+static EventLoopHelperFunctions sleeping{ nullptr, nullptr, nullptr, sleepUntilInterrupt };
+static EventLoop<1024, 8> loop(&sleeping);
+static TaskHandle writer, sampler;
+
+static uint64_t lines_left, stall_sum, stall_max, written;
+static uint32_t last_sample;
+static int32_t late_max;
+
+static void sample()
+{
+    const uint32_t now = Time::micros();
+    const int32_t late = (int32_t)(now - last_sample) - 1000;
+    if(late > late_max)
+        late_max = late;
+    last_sample = now;
+}
+
+template<typename Pipe>
+static void writeLine(Pipe* pipe)
+{
+    char line[48];
+    snprintf(line, sizeof(line), "status %08u: all sensors nominal\r\n", (unsigned)lines_left);
+    const uint64_t start = bench::nowNs();
+    *pipe << line;
+    const uint64_t stall = bench::nowNs() - start;
+    stall_sum += stall;
+    if(stall > stall_max)
+        stall_max = stall;
+    written += strlen(line);
+    if(--lines_left)
+        return;
+    loop.clearInterval(writer);
+    loop.clearInterval(sampler);
+}
+
+static std::atomic<uint64_t> received(0);
+static void readWire()
+{
+    char buffer[256];
+    ssize_t n;
+    while((n = read(wire_pipe[0], buffer, sizeof(buffer))) > 0)
+        received += n;
+}
+
+static char rx_ring[128];
+static PipeIO<simulatedSendByte<wire>> receiver(rx_ring, sizeof(rx_ring));
+static uint64_t received_bytes, received_frames;
+
+static bool benchReceive(bench::Suite& suite, bool lines)
+{
+    const uint64_t ops = suite.iterations(200000);
+    received_bytes = received_frames = 0;
+    receiver.dispatchOn(loop);
+    if(lines)
+        receiver.frameLines('\n');
+    else
+        receiver.frameNone();
+    receiver.onData = [](PipeIO<simulatedSendByte<wire>>*, const RxSpan& frame){
+        received_bytes += frame.length();
+        received_frames++;
+    };
+    char line[48];
+    const int length = snprintf(line, sizeof(line), "status %08u: all sensors nominal\r\n", 0u);
+    suite.run("pipe.receive_line", lines ? "framing=lines" : "framing=none", ops, length, [&](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            for(int k=0; k<length; k++)
+            {
+                receiver.receive(line[k]);
+                loop.runOnce(0);
+            }
+    });
+    // lines leave out the '\n', the runs of suite.run() add up
+    const uint64_t per_line = lines ? length-1 : length;
+    return receiver.rxDropped() == 0 && received_bytes % per_line == 0 && (!lines || received_bytes/per_line == received_frames);
+}
+
+// a file descriptor that /dev/null is dup2()'d to, fdSendByte<> and fdWrite<> need it at compile time
+static constexpr int null_fd = 63;
+static PipeIO<fdSendByte<null_fd>> null_bytes(nullptr, 0);
+static PipeIO<fdSendByte<null_fd>, 0, fdWrite<null_fd>> null_bulk(nullptr, 0);
+
+static char memory[1 << 16];
+static uint32_t memory_length = 0;
+static void toMemory(char c) { memory[memory_length++ & 0xFFFF] = c; }
+static void toMemoryBulk(const char* data, std::size_t length)
+{
+    const uint32_t at = memory_length & 0xFFFF;
+    const std::size_t first = length < sizeof(memory) - at ? length : sizeof(memory) - at;
+    memcpy(memory + at, data, first);
+    memcpy(memory, data + first, length - first);
+    memory_length += length;
+}
+static PipeIO<toMemory> memory_bytes(nullptr, 0);
+static PipeIO<toMemory, 0, toMemoryBulk> memory_bulk(nullptr, 0);
+
+// the "DMA": started by the bulk sender, completed by drain() as its interrupt would
+static const char* dma_data = nullptr;
+static std::size_t dma_length = 0;
+static void dmaStart(const char* data, std::size_t length)
+{
+    dma_data = data;
+    dma_length = length;
+}
+static PipeIO<toMemory, 128> ring_isr(nullptr, 0);
+static PipeIO<toMemory, 128, dmaStart> ring_dma(nullptr, 0);
+
+static void drain(PipeIO<toMemory, 128>& pipe)
+{
+    while(pipe.txBusy())
+        pipe.txEmpty();
+}
+static void drain(PipeIO<toMemory, 128, dmaStart>& pipe)
+{
+    while(pipe.txBusy())
+    {
+        const std::size_t length = dma_length;
+        dma_length = 0;
+        toMemoryBulk(dma_data, length);
+        pipe.txEmpty();
+    }
+}
+template<typename Pipe>
+static void drain(Pipe&) {}
+
+enum class Write { BYTES, WRITE, WRITEV };
+
+template<typename Pipe>
+static void writeMessage(Pipe& pipe, const char* message, std::size_t length, Write how)
+{
+    switch(how)
+    {
+    case Write::BYTES:
+        for(std::size_t i=0; i<length; i++)
+            pipe.sendByte(message[i]);
+        break;
+    case Write::WRITE:
+        pipe.write(message, length);
+        break;
+    case Write::WRITEV:
+        pipe.writev({ { message, 4 }, { message + 4, length - 8 }, { message + length - 4, 4 } });
+        break;
+    }
+    drain(pipe);
+}
+
+// a thousand or so messages of varied bytes, 0s included, must come out as written
+template<typename Pipe>
+static bool sameOut(Pipe& pipe, std::size_t length, Write how)
+{
+    static char message[1024];
+    static char want[sizeof(memory)];
+    const uint32_t count = sizeof(memory) / length / 2;
+    memory_length = 0;
+    for(uint32_t k=0; k<count; k++)
+    {
+        for(std::size_t i=0; i<length; i++)
+            message[i] = want[k*length + i] = (char)(k*31 + i*7);
+        writeMessage(pipe, message, length, how);
+    }
+    return memory_length == count*length && memcmp(memory, want, memory_length) == 0;
+}
+
+template<typename Pipe>
+static bool benchBulk(bench::Suite& suite, const char* sink, const char* with, Pipe& pipe, std::size_t length, Write how)
+{
+    const bool to_null = strcmp(sink, "null") == 0;
+    const bool same = to_null || sameOut(pipe, length, how);
+    static char message[1024];
+    memset(message, 'x', sizeof(message));
+    const uint64_t ops = suite.iterations((to_null && how == Write::BYTES ? 200000 : 2000000) / length);
+    char param[64];
+    snprintf(param, sizeof(param), "sink=%s,bytes=%zu,with=%s", sink, length, with);
+    suite.run("pipe.bulk_write", param, ops, length, [&](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            writeMessage(pipe, message, length, how);
+    });
+    return same;
+}
+
+static bool benchBulks(bench::Suite& suite)
+{
+    const int fd = open("/dev/null", O_WRONLY);
+    if(fd < 0 || dup2(fd, null_fd) < 0)
+        return false;
+    close(fd);
+    bool ok = true;
+    for(std::size_t length : {64, 1024})
+    {
+        ok &= benchBulk(suite, "null", "sendByte", null_bytes, length, Write::BYTES);
+        ok &= benchBulk(suite, "null", "write", null_bulk, length, Write::WRITE);
+        ok &= benchBulk(suite, "memory", "sendByte", memory_bytes, length, Write::BYTES);
+        ok &= benchBulk(suite, "memory", "write", memory_bulk, length, Write::WRITE);
+    }
+    // 64 byte messages fit the ring, nothing is dropped
+    ok &= benchBulk(suite, "ring128", "isr,sendByte", ring_isr, 64, Write::BYTES);
+    ok &= benchBulk(suite, "ring128", "isr,write", ring_isr, 64, Write::WRITE);
+    ok &= benchBulk(suite, "ring128", "dma,sendByte", ring_dma, 64, Write::BYTES);
+    ok &= benchBulk(suite, "ring128", "dma,write", ring_dma, 64, Write::WRITE);
+    ok &= benchBulk(suite, "ring128", "dma,writev", ring_dma, 64, Write::WRITEV);
+    close(null_fd);
+    return ok && ring_isr.txDropped() == 0 && ring_dma.txDropped() == 0;
+}
+
+template<typename Pipe>
+static bool benchStall(bench::Suite& suite, const char* mode, Pipe& pipe)
+{
+    const uint64_t lines = suite.iterations(400);
+    lines_left = lines;
+    stall_sum = stall_max = written = 0;
+    late_max = 0;
+    received = 0;
+    last_sample = Time::micros();
+    sampler = loop.setInterval(sample, 1);
+    writer = loop.setInterval(writeLine<Pipe>, 5, &pipe);
+    loop.run();
+
+    // everything written must reach the far end of the wire
+    const uint64_t deadline = bench::nowNs() + 2000000000ULL;
+    while(received < written && bench::nowNs() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    suite.record("pipe.write_stall", mode, lines, (double)stall_sum/lines, (double)written/lines);
+    suite.record("pipe.write_stall_max", mode, lines, (double)stall_max, (double)written/lines);
+    suite.record("loop.interval_late_max", mode, lines, (double)late_max*1000, 0);
+    return received == written;
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    if(wire_pipe[1] < 0)
+    {
+        fprintf(stderr, "bench_pipeio: no pipe for the wire\n");
+        return 1;
+    }
+    std::thread reader(readWire);
+    wire.onTxComplete([](){ async.txEmpty(); });
+
+    bool ok = benchStall(suite, "tx=blocking", blocking);
+    ok &= benchStall(suite, "tx=ring64", async);
+    ok &= async.txDropped() == 0;
+    ok &= benchReceive(suite, true);
+    ok &= benchReceive(suite, false);
+    ok &= benchBulks(suite);
+
+    async.flush();
+    close(wire_pipe[1]);
+    reader.join();
+    if(!ok)
+    {
+        fprintf(stderr, "bench_pipeio: bytes went missing (%u sent, %u received dropped), the results are not comparable\n",
+                async.txDropped(), receiver.rxDropped());
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,189 @@
+#include "../include/EventLoopHost.h"
+#include "../include/Promise.h"
+#include "bench.h"
+
+/*
+    Latency of a flow of depth steps, from building it to its last step, against the chain of nextTick() callbacks
+    doing the same: every step gets a 32 byte state, changes it and hands it to the next one.
+    The promise chain moves the state through the slots of the pool, the callbacks copy it through the queue.
+    Then all()/any() over 4 promises, from making them to the joined continuation.
+    Before measuring, a loop with room for one task of the pool must refuse resolve() and then() without changing
+    the promise, and a chain it cannot go on with must give its slots back, or the process fails.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint64_t executed = 0;
+static uint64_t failures = 0;
+
+static EventLoopHelperFunctions helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },
+    nullptr,
+};
+
+struct State
+{
+    int64_t a, b, c, d;
+};
+
+using Loop = EventLoop<4096, 0>;
+static Loop loop(&helper_functions);
+static PromisePool<Loop, 80, 12*sizeof(void*)> promises(loop);
+
+static State step(State s) { s.a += s.d; s.d++; return s; }
+static void sink(State s) { executed += s.a; }
+
+static void hop(State s, uint32_t left)
+{
+    s = step(s);
+    if(left)
+        loop.nextTick(hop, s, left-1);
+    else
+        sink(s);
+}
+
+static void drain()
+{
+    while(loop.hasPendingTasks())
+        loop.runOnce(0);
+}
+
+// the queue of this loop holds one task of the pool, or one plain task, at a time
+using TinyLoop = EventLoop<64, 0>;
+static uint64_t tiny_failures = 0;
+static EventLoopHelperFunctions tiny_helper_functions{
+    nullptr, nullptr,
+    [](void*){ tiny_failures++; },
+    nullptr,
+};
+static TinyLoop tiny_loop(&tiny_helper_functions);
+static PromisePool<TinyLoop, 8> tiny_promises(tiny_loop);
+static uint32_t tiny_runs = 0;
+static int32_t count(int32_t v) { tiny_runs++; return v+1; }
+static void blocker() {}
+
+static void tinyDrain()
+{
+    while(tiny_loop.hasPendingTasks())
+        tiny_loop.runOnce(0);
+}
+
+static bool fullLoopLeavesNothing()
+{
+    // resolve() of a chained promise, refused while the queue is full and taken once it is not
+    Promise<int32_t> chained = tiny_promises.make<int32_t>();
+    Promise<int32_t> chained_next = chained.then(count);
+    tiny_loop.nextTick(blocker);
+    const bool resolve_refused = !chained.resolve(1) && chained && !chained.settled() && chained_next;
+    tinyDrain();
+    const bool resolve_taken = chained.resolve(1);
+    tinyDrain();
+    chained_next.drop();
+
+    // then() of a settled promise, the same
+    Promise<int32_t> settled = tiny_promises.resolved(1);
+    tiny_loop.nextTick(blocker);
+    const bool then_refused = !settled.then(count) && settled.settled();
+    tinyDrain();
+    Promise<int32_t> settled_next = settled.then(count);
+    const bool then_taken = (bool)settled_next;
+    tinyDrain();
+    settled_next.drop();
+
+    // the first step runs while its own task fills the queue, the second cannot be queued, the chain is given back
+    Promise<int32_t> head = tiny_promises.make<int32_t>();
+    Promise<int32_t> tail = head.then(count).then(count);
+    head.resolve(1);
+    tinyDrain();
+    const bool chain_given_back = !tail;
+
+    // dropping the head of a chain gives back the rest of it
+    Promise<int32_t> dropped = tiny_promises.make<int32_t>();
+    Promise<int32_t> dropped_tail = dropped.then(count).then(count);
+    dropped.drop();
+
+    return resolve_refused && resolve_taken && then_refused && then_taken && chain_given_back && !dropped_tail
+        && tiny_runs == 3 && tiny_failures == 3 && tiny_promises.used() == 0;
+}
+
+static void benchChain(bench::Suite& suite, uint32_t depth)
+{
+    const std::string param = "depth=" + std::to_string(depth);
+    const uint64_t chains = suite.iterations(2000000)/depth;
+
+    suite.run("callback.chain", param, chains, sizeof(State), [depth](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+        {
+            loop.nextTick(hop, State{1, 2, 3, 4}, depth-1);
+            drain();
+        }
+    });
+    suite.run("promise.chain", param, chains, sizeof(State), [depth](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+        {
+            Promise<State> first = promises.make<State>();
+            Promise<State> last = first;
+            for(uint32_t n=0; n<depth; n++)
+                last = last.then(step);
+            if(!last.then(sink).drop())
+                failures++;
+            first.resolve(State{1, 2, 3, 4});
+            drain();
+        }
+    });
+}
+
+static void sum4(std::tuple<int32_t, int32_t, int32_t, int32_t> t)
+{ executed += std::get<0>(t) + std::get<1>(t) + std::get<2>(t) + std::get<3>(t); }
+static void first(int32_t v) { executed += v; }
+
+static void benchJoins(bench::Suite& suite)
+{
+    suite.run("promise.all", "promises=4", suite.iterations(500000), 4*sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+        {
+            Promise<int32_t> p[4] = {promises.make<int32_t>(), promises.make<int32_t>(), promises.make<int32_t>(), promises.make<int32_t>()};
+            if(!promises.all(p[0], p[1], p[2], p[3]).then(sum4).drop())
+                failures++;
+            for(int32_t n=0; n<4; n++)
+                p[n].resolve(n);
+            drain();
+        }
+    });
+    suite.run("promise.any", "promises=4", suite.iterations(500000), sizeof(int32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+        {
+            Promise<int32_t> p[4] = {promises.make<int32_t>(), promises.make<int32_t>(), promises.make<int32_t>(), promises.make<int32_t>()};
+            if(!promises.any(p[0], p[1], p[2], p[3]).then(first).drop())
+                failures++;
+            for(int32_t n=0; n<4; n++)
+                p[n].resolve(n);
+            drain();
+        }
+    });
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    if(!fullLoopLeavesNothing())
+    {
+        fprintf(stderr, "bench: a full loop changed a promise or kept its slots, %u ran, %llu refused, %u promises left\n",
+                tiny_runs, (unsigned long long)tiny_failures, tiny_promises.used());
+        return 1;
+    }
+
+    for(uint32_t depth : {1, 4, 16, 64})
+        benchChain(suite, depth);
+    benchJoins(suite);
+
+    bench::doNotOptimize(executed);
+    if(failures || promises.used())
+    {
+        fprintf(stderr, "bench: %llu allocations failed, %u promises left, the results are not comparable\n",
+                (unsigned long long)failures, promises.used());
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,85 @@
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    Task dispatch: what the loop pays per task it visits, across many distinct callables,
+    so the call sites stay polymorphic like in a real firmware.
+*/
+
+int64_t Time::s_offset = 0;
+
+static uint64_t executed = 0;
+static uint64_t failures = 0;
+
+static EventLoopHelperFunctions helper_functions{
+    nullptr, nullptr,
+    [](void*){ failures++; },   // onTaskAllocationFailed, any failure spoils the numbers
+    nullptr,
+};
+
+template<int N>
+static void work(int32_t k) { executed += k + N; }
+
+// no resident slots, every timer is visited in the queue on every pass: type, time left, copy and destroy
+static EventLoop<4096, 0> loop(&helper_functions);
+
+template<int ...N>
+struct Callables
+{
+    static void nextTick() { int dummy[] = { (loop.nextTick(work<N>, N), 0)... }; (void)dummy; }
+    static void setTimeout(uint32_t ms) { int dummy[] = { (loop.setTimeout(work<N>, ms, N), 0)... }; (void)dummy; }
+    static void setInterval(uint16_t ms) { int dummy[] = { (loop.setInterval(work<N>, ms, N), 0)... }; (void)dummy; }
+    static constexpr std::size_t count = sizeof...(N);
+};
+using Sixteen = Callables<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15>;
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+    const double size = make_task(work<0>).setArgs({0}).size();
+
+    // pending timeouts only: requeued on every pass without running
+    Sixteen::setTimeout(60000);
+    Sixteen::setTimeout(60000);
+    suite.run("dispatch.requeue_timeout", "tasks=32", suite.iterations(200000)*32, size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops/32; i++)
+            loop.runOnce(0);
+    });
+    for(auto f : { work<0>, work<1>, work<2>, work<3>, work<4>, work<5>, work<6>, work<7>,
+                   work<8>, work<9>, work<10>, work<11>, work<12>, work<13>, work<14>, work<15> })
+        loop.clearTimeout(f);
+    while(loop.hasPendingTasks())
+        loop.runOnce(0);
+
+    // intervals firing on every pass: exec plus requeue
+    Sixteen::setInterval(1);
+    Sixteen::setInterval(1);
+    suite.run("dispatch.fire_interval", "tasks=32", suite.iterations(200000)*32, size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops/32; i++)
+            loop.runOnce(1);
+    });
+    for(auto f : { work<0>, work<1>, work<2>, work<3>, work<4>, work<5>, work<6>, work<7>,
+                   work<8>, work<9>, work<10>, work<11>, work<12>, work<13>, work<14>, work<15> })
+        loop.clearInterval(f);
+    while(loop.hasPendingTasks())
+        loop.runOnce(0);
+
+    // plain tasks: push, exec and pop once
+    suite.run("dispatch.next_tick", "tasks=32", suite.iterations(200000)*32, size, [](uint64_t ops){
+        for(uint64_t i=0; i<ops/32; i++)
+        {
+            Sixteen::nextTick();
+            Sixteen::nextTick();
+            while(loop.hasPendingTasks())
+                loop.runOnce(0);
+        }
+    });
+
+    bench::doNotOptimize(executed);
+    if(failures)
+    {
+        fprintf(stderr, "bench: %llu task allocations failed, the results are not comparable\n", (unsigned long long)failures);
+        return 1;
+    }
+    return suite.finish();
+}
@@ -0,0 +1,181 @@
+#include <atomic>
+#include <thread>
+#include "../include/EventLoopHost.h"
+#include "bench.h"
+
+/*
+    The read path of the clock: Time::absolute() and Time::absoluteShort() through the sequence number,
+    against the copy under CriticalSection they replace (LockedClock below, what absolute() did before),
+    and the elapsed time of one loop pass in 48 bit Time against 32 bit ShortTime.
+    Then the latency of the "timer ISR": a thread playing it calls tick() while the loop thread keeps reading,
+    tick_latency is the time tick() takes from the moment it is raised. Locked readers hold it off, on avr for the
+    copy of 6 bytes with the SREG saved and restored, on a host for as long as the reader holds the lock.
+    With a TickCounter, a SimulatedTickTimer at 100Hz: micros() read across a wrap whose ISR has not run must not go
+    back, or the process fails, then the cost of the read and how late setTimeoutUs() fires on the host clock.
+*/
+
+int64_t Time::s_offset = 0;
+
+// Time::absolute() before the sequence number, the same 48 bit copy under the same guard
+class LockedClock
+{
+private:
+    static Time& getInstance() { static Time self(0); return self; }
+public:
+    static Time absolute()
+    {
+        Time temp;
+        { CriticalSection guard; temp = getInstance(); }
+        return temp + platformMillis();
+    }
+    static void tick(int16_t ms=1) { CriticalSection guard; getInstance() = getInstance() + ms; }
+};
+
+static uint64_t sink = 0;
+
+static void benchReads(bench::Suite& suite)
+{
+    const uint64_t ops = suite.iterations(5000000);
+    suite.run("time.absolute", "read=locked", ops, sizeof(Time), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += LockedClock::absolute();
+    });
+    suite.run("time.absolute", "read=seqlock", ops, sizeof(Time), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += Time::absolute();
+    });
+    suite.run("time.absolute_short", "read=seqlock", ops, sizeof(ShortTime), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += Time::absoluteShort().ms();
+    });
+
+    // what run() does every pass
+    suite.run("time.pass_elapsed", "type=Time", ops, sizeof(Time), [](uint64_t ops){
+        Time prev = LockedClock::absolute();
+        for(uint64_t i=0; i<ops; i++)
+        {
+            Time now = LockedClock::absolute();
+            sink += (uint32_t)(now-prev);
+            prev = now;
+        }
+    });
+    suite.run("time.pass_elapsed", "type=ShortTime", ops, sizeof(ShortTime), [](uint64_t ops){
+        ShortTime prev = Time::absoluteShort();
+        for(uint64_t i=0; i<ops; i++)
+        {
+            ShortTime now = Time::absoluteShort();
+            sink += now-prev;
+            prev = now;
+        }
+    });
+}
+
+// the reader spins until the ticker is done, ns_per_op is the mean latency, the max is recorded on its own
+template<typename Read, typename Tick>
+static void benchTickLatency(bench::Suite& suite, const char* param, Read read, Tick tick)
+{
+    const uint64_t ticks = suite.iterations(20000);
+    std::atomic<bool> done(false);
+    uint64_t total = 0, worst = 0;
+    std::thread isr([&](){
+        for(uint64_t i=0; i<ticks; i++)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            const uint64_t raised = bench::nowNs();
+            tick();
+            const uint64_t latency = bench::nowNs() - raised;
+            total += latency;
+            if(latency > worst)
+                worst = latency;
+        }
+        done.store(true, std::memory_order_release);
+    });
+    while(!done.load(std::memory_order_acquire))
+        sink += read();
+    isr.join();
+    suite.record("time.tick_latency", param, ticks, (double)total/ticks, 0);
+    suite.record("time.tick_latency_max", param, ticks, (double)worst, 0);
+}
+
+// a read between the wrap of the counter and its ISR, what a read with interrupts off sees on avr
+static bool raceCheck()
+{
+    SimulatedTickTimer timer(2500, 10000);
+    bool ok = true;
+    for(uint32_t tick=0; tick<1000; tick++)
+    {
+        while(timer.counts() < 2400)
+            timer.advance(300);
+        const uint32_t before = Time::micros();
+        timer.advance(300);     // wraps, the flag is raised
+        const uint32_t wrapped = Time::micros();
+        timer.serve();
+        const uint32_t served = Time::micros();
+        ok &= (int32_t)(wrapped-before) > 0 && (int32_t)(served-wrapped) >= 0;
+    }
+    return ok;
+}
+
+static void benchMicros(bench::Suite& suite)
+{
+    const uint64_t ops = suite.iterations(5000000);
+    suite.run("time.micros", "counter=none", ops, sizeof(uint32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += Time::micros();
+    });
+    SimulatedTickTimer timer(2500, 10000);
+    suite.run("time.micros", "counter=simulated", ops, sizeof(uint32_t), [](uint64_t ops){
+        for(uint64_t i=0; i<ops; i++)
+            sink += Time::micros();
+    });
+}
+
+static EventLoopHelperFunctions sleeping{ nullptr, nullptr, nullptr, sleepUntilInterrupt };
+static EventLoop<1024, 8> loop;
+static int64_t late_sum;
+static int32_t late_max;
+
+static void lateBy(uint32_t armed, uint32_t us)
+{
+    const int32_t late = (int32_t)(Time::micros() - armed - us);
+    late_sum += late;
+    if(late > late_max)
+        late_max = late;
+}
+
+// ns_per_op is how late the timeouts fire. a spinning loop shows what the loop itself adds, a sleeping one
+// sleeps for the whole ms and runs passes for the rest, what it adds on top is how much the OS oversleeps
+static void benchTimeoutUs(bench::Suite& suite, const char* idle, const EventLoopHelperFunctions* helper_functions)
+{
+    const uint64_t timeouts = suite.iterations(4000);
+    late_sum = late_max = 0;
+    loop.setHelperFunctions(helper_functions);
+    for(uint64_t i=0; i<timeouts; i++)
+    {
+        const uint32_t us = 100 + i*337%2900;
+        loop.setTimeoutUs(lateBy, us, Time::micros(), us);
+        loop.run();
+    }
+    suite.record("loop.timeout_us_late_mean", idle, timeouts, (double)late_sum*1000/timeouts, 0);
+    suite.record("loop.timeout_us_late_max", idle, timeouts, (double)late_max*1000, 0);
+}
+
+int main(int argc, char** argv)
+{
+    bench::Suite suite(argc, argv);
+
+    if(!raceCheck())
+    {
+        fprintf(stderr, "bench_time: micros() went back across a counter wrap, the results are not comparable\n");
+        return 1;
+    }
+    benchReads(suite);
+    benchTickLatency(suite, "read=locked", [](){ return (uint64_t)LockedClock::absolute(); }, [](){ LockedClock::tick(); });
+    benchTickLatency(suite, "read=seqlock", [](){ return (uint64_t)Time::absolute(); }, [](){ Time::tick(); });
+    benchMicros(suite);
+    benchTimeoutUs(suite, "idle=spin", nullptr);
+    benchTimeoutUs(suite, "idle=sleep", &sleeping);
+
+    bench::doNotOptimize(sink);
+    return suite.finish();
+}
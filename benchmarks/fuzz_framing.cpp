@@ -0,0 +1,225 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../include/EventLoopHost.h"
+#include "../include/Framing.h"
+
+/*
+    Fuzzing FrameDecoder and the encoders of Framing.h. Each input goes through:
+    - a decoder per codec and CRC, fed byte by byte and in random pieces: both must hand out the same frames,
+      none longer than the buffer, and every frame handed out must encode back to one that decodes the same
+    - writeFrame() and FrameWriter with the input as payload: the same bytes, no delimiter before the end,
+      no longer than encodedLength(), and they decode back to the input
+    - every CRC kernel, which must agree
+    Anything else aborts. With -DEVENTLOOP_LIBFUZZER=ON and clang it builds for libFuzzer
+    (e.g. "fuzz_framing -max_len=2048 corpus/"), otherwise it runs on its own: generated inputs,
+    random bytes, bytes around the delimiters and streams of valid frames with bits flipped, or the files given.
+*/
+
+int64_t Time::s_offset = 0;
+
+#define CHECK(condition) do { if(!(condition)) { fprintf(stderr, "fuzz_framing: %s failed at line %d\n", #condition, __LINE__); abort(); } } while(0)
+
+struct Memory
+{
+    std::vector<uint8_t> bytes;
+    void operator()(char c) { bytes.push_back((uint8_t)c); }
+};
+
+using Frames = std::vector<std::vector<uint8_t>>;
+
+template<class Codec, class Crc>
+struct Target
+{
+    static constexpr std::size_t max_frame = 300;
+    using Decoder = FrameDecoder<Codec, Crc, max_frame>;
+
+    static Frames* out;
+    static void collect(Decoder*, const uint8_t* payload, uint16_t length)
+    {
+        CHECK(length + sizeof(typename Crc::value_type) <= max_frame);
+        out->emplace_back(payload, payload + length);
+    }
+
+    static Frames decode(const std::vector<uint8_t>& bytes, const uint8_t* cuts, std::size_t cut_count)
+    {
+        Frames frames;
+        out = &frames;
+        Decoder decoder;
+        decoder.onFrame = collect;
+        if(!cuts)
+            for(uint8_t c : bytes)
+                decoder.receive(c);
+        else
+            for(std::size_t i=0, at=0; at < bytes.size(); i++)
+            {
+                const std::size_t n = cut_count ? cuts[i % cut_count] % 97 + 1 : bytes.size();
+                const std::size_t piece = n < bytes.size() - at ? n : bytes.size() - at;
+                decoder.receive(bytes.data() + at, piece);
+                at += piece;
+            }
+        CHECK(decoder.frames() == frames.size());
+        return frames;
+    }
+
+    static void run(const uint8_t* data, std::size_t size)
+    {
+        const std::vector<uint8_t> input(data, data + size);
+        const Frames frames = decode(input, nullptr, 0);
+        CHECK(decode(input, data, size < 16 ? size : 16) == frames);
+
+        for(const auto& frame : frames)
+        {
+            Memory encoded;
+            writeFrame<Codec, Crc>(encoded, frame.data(), frame.size());
+            CHECK(decode(encoded.bytes, nullptr, 0) == Frames{frame});
+        }
+
+        Memory encoded, streamed;
+        writeFrame<Codec, Crc>(encoded, data, size);
+        FrameWriter<Codec, Crc, Memory> writer(streamed);
+        writer.write(data, size / 2);
+        for(std::size_t i = size / 2; i < size; i++)
+            writer.write(data[i]);
+        writer.end();
+        CHECK(encoded.bytes == streamed.bytes);
+        CHECK(encoded.bytes.size() <= Codec::encodedLength(size + sizeof(typename Crc::value_type)) + 1);
+        CHECK(memchr(encoded.bytes.data(), Codec::delimiter, encoded.bytes.size() - 1) == nullptr);
+        CHECK(encoded.bytes.back() == Codec::delimiter);
+        uint16_t length = encoded.bytes.size() - 1;
+        CHECK(Codec::decode(encoded.bytes.data(), length));
+        CHECK(length == size + sizeof(typename Crc::value_type) && (size == 0 || memcmp(encoded.bytes.data(), data, size) == 0));
+    }
+};
+template<class Codec, class Crc>
+Frames* Target<Codec, Crc>::out = nullptr;
+
+template<template<CrcKernel> class C>
+static void kernelsAgree(const uint8_t* data, std::size_t size)
+{
+    const auto want = C<CrcKernel::BITWISE>::of(data, size);
+    CHECK(C<CrcKernel::NIBBLE>::of(data, size) == want);
+    CHECK(C<CrcKernel::TABLE>::of(data, size) == want);
+    CHECK(C<CrcKernel::SLICE4>::of(data, size) == want);
+    CHECK(C<CrcKernel::SLICE8>::of(data, size) == want);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, std::size_t size)
+{
+    if(size > 4096)
+        return 0;
+    Target<Cobs, Crc16<>>::run(data, size);
+    Target<Cobs, Crc32<>>::run(data, size);
+    Target<Slip, Crc16<>>::run(data, size);
+    Target<Slip, Crc32<>>::run(data, size);
+    kernelsAgree<Crc16>(data, size);
+    kernelsAgree<Crc32>(data, size);
+    return 0;
+}
+
+#ifndef EVENTLOOP_LIBFUZZER
+
+static uint64_t state = 0x9E3779B97F4A7C15ULL;
+static uint64_t random64()
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// valid frames of both codecs back to back, then a few bits flipped, bytes dropped or doubled
+static std::vector<uint8_t> mangledFrames()
+{
+    Memory stream;
+    const uint8_t frames = random64() % 6;
+    for(uint8_t i=0; i<frames; i++)
+    {
+        std::vector<uint8_t> payload(random64() % 300);
+        for(auto& b : payload)
+            b = random64() % 3 ? (uint8_t)random64() : 0;
+        switch(random64() % 4)
+        {
+        case 0: writeFrame<Cobs, Crc16<>>(stream, payload.data(), payload.size()); break;
+        case 1: writeFrame<Cobs, Crc32<>>(stream, payload.data(), payload.size()); break;
+        case 2: writeFrame<Slip, Crc16<>>(stream, payload.data(), payload.size()); break;
+        default: writeFrame<Slip, Crc32<>>(stream, payload.data(), payload.size()); break;
+        }
+    }
+    auto& bytes = stream.bytes;
+    for(uint8_t flips = random64() % 4; flips && !bytes.empty(); flips--)
+    {
+        const std::size_t at = random64() % bytes.size();
+        switch(random64() % 3)
+        {
+        case 0: bytes[at] ^= 1 << random64() % 8; break;
+        case 1: bytes.erase(bytes.begin() + at); break;
+        default: bytes.insert(bytes.begin() + at, bytes[at]); break;
+        }
+    }
+    return bytes;
+}
+
+static std::vector<uint8_t> generated()
+{
+    std::vector<uint8_t> bytes(random64() % 700);
+    switch(random64() % 3)
+    {
+    case 0:
+        for(auto& b : bytes)
+            b = random64();
+        break;
+    case 1:
+        for(auto& b : bytes)
+        {
+            static const uint8_t special[] = { 0x00, 0x01, 0xFE, 0xFF, 0xC0, 0xDB, 0xDC, 0xDD };
+            b = random64() % 4 ? special[random64() % 8] : (uint8_t)random64();
+        }
+        break;
+    default:
+        bytes = mangledFrames();
+    }
+    return bytes;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t runs = 20000;
+    int files = 0;
+    for(int i=1; i<argc; i++)
+    {
+        if(strcmp(argv[i], "--quick") == 0)
+        {
+            runs = 1000;
+            continue;
+        }
+        FILE* f = fopen(argv[i], "rb");
+        if(!f)
+        {
+            fprintf(stderr, "fuzz_framing: cannot open %s\n", argv[i]);
+            return 1;
+        }
+        std::vector<uint8_t> bytes;
+        int c;
+        while((c = fgetc(f)) != EOF)
+            bytes.push_back(c);
+        fclose(f);
+        LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+        files++;
+    }
+    if(files)
+    {
+        printf("fuzz_framing: %d files ok\n", files);
+        return 0;
+    }
+    for(uint64_t i=0; i<runs; i++)
+    {
+        const std::vector<uint8_t> bytes = generated();
+        LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+    }
+    printf("fuzz_framing: %llu inputs ok\n", (unsigned long long)runs);
+    return 0;
+}
+
+#endif
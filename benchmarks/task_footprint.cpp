@@ -0,0 +1,34 @@
+#include "../include/EventLoopHost.h"
+
+/*
+    Not a benchmark: a firmware-like mix of callables, built with -Os so "size" of the binary
+    tells how much code and tables every Callable instantiation costs.
+*/
+
+int64_t Time::s_offset = 0;
+EventLoop<256> eventloop;
+TaskInterface* handlers[8];
+volatile int32_t sink;
+
+template<int N>
+void work(int32_t k) { sink = k + N; }
+
+template<int N>
+void schedule()
+{
+    eventloop.nextTick(work<N>, N);
+    eventloop.setTimeout(work<N>, 10*N, N);
+    eventloop.setInterval(work<N>, 5*N+1, N);
+    eventloop.bindEventHandler(handlers[N%8], [](int32_t k){ sink = k*N; }, N);
+}
+
+template<int ...N>
+void scheduleAll() { int dummy[] = { (schedule<N>(), 0)... }; (void)dummy; }
+
+int main()
+{
+    scheduleAll<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15>();
+    for(int i=0; i<100; i++)
+        eventloop.runOnce(1);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include <thread>
+#include "../../include/EventLoopHost.h"
+
+/*
+    The timeout_task example on a workstation:
+    another thread plays the timer ISR, posting into the loop instead of calling nextTick()
+*/
+
+EventLoop<256> eventloop;                       // create an eventloop with 256bytes queue
+int64_t Time::s_offset = 0;                     // offset to the real time in milliseconds
+
+char io_buffer[32];
+PipeIO<stdoutSendByte, 0, stdoutWrite> io(io_buffer, sizeof(io_buffer));   // PipeIO writing to stdout, a write(2) per piece
+
+const EventLoopHelperFunctions helper_functions{
+    nullptr,                                    // preQueueProcess
+    nullptr,                                    // postQueueProcess
+    nullptr,                                    // onTaskAllocationFailed
+    sleepUntilInterrupt,                        // idle: blocks on a condvar until the next deadline or a wakeup()
+};
+
+int main()
+{
+    eventloop.setHelperFunctions(&helper_functions);
+
+    int32_t count = 0;
+    TaskHandle ticker = eventloop.setInterval([&count](){
+        io << "tick " << count++ << " at " << (int32_t)Time::absolute() << "ms\n";
+    }, 100);
+    eventloop.setTimeout([ticker](){
+        eventloop.clearInterval(ticker);
+        io << "interval cleared\n";
+    }, 550);
+
+    std::thread isr([](){                       // the "ISR", only post() and wakeup() may be used from here
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        eventloop.post([](int v){ io << "posted " << (int32_t)v << '\n'; }, 42);
+    });
+
+    eventloop.run();                            // returns once every task is done
+    isr.join();
+
+    const auto& stats = eventloop.idleStats();
+    io << "iterations " << (int32_t)stats.iterations << ", idle " << (int32_t)stats.idle_ms << "ms\n";
+#ifdef EVENTLOOP_INSTRUMENT
+    dumpStats(io, eventloop.stats());           // built as host_eventloop_instrumented
+#endif
+    return 0;
+}
@@ -9,24 +9,32 @@ constexpr long BAUD = (CLOCK_FREQ/(BAUD_RATE*16UL)-1);
 
 void uart_send_byte(char c)
 {
-    while(!(UCSR0A & (1<<UDRE0)));  // wait for empty transmit buffer
+    while(!(UCSR0A & (1<<UDRE0)));  // wait for empty transmit buffer, never waits with the tx ring below
     UDR0 = c;
 }
 
-char uart_buffer[100];  // buffer for received data
-PipeIO<uart_send_byte> uart(uart_buffer, sizeof(uart_buffer));  // use uart as a PipeIO object
+EventLoop<256> eventloop;
+int64_t Time::s_offset = 0;
+
+using Uart = PipeIO<uart_send_byte, 64>;    // writes go to a 64 byte ring sent by the TX complete interrupt
+char uart_buffer[100];  // the ring of received data
+Uart uart(uart_buffer, sizeof(uart_buffer));  // use uart as a PipeIO object
+
+ISR(USART_TX_vect, ISR_BLOCK)
+{
+    uart.txEmpty();     // the byte is out, hand the next one to UDR0
+}
 
 ISR(USART_RX_vect, ISR_BLOCK)
 {
-    uint8_t c = UDR0;   // read byte from UDR0
-    if(uart.flags() & (uint8_t)PipeIOFlags::RECVBUSY)
-        return;         // read busy -> ignore, no echo
-    if(c == 8)  // backspace
-        uart.buffer_pop();
-    else
-        uart.buffer_push(c);
-    UDR0 = c;           // echo back
-    uart.checkEvents(); // direct execute the callback function, NOTICE: not execute in the eventloop!
+    uart.receive(UDR0); // into the ring, a complete line posts onData to the eventloop
+}
+
+uint8_t lines_left = 20;
+void printLines()   // writes as many lines as the ring takes, onDrain brings it back for the rest
+{
+    while(lines_left && uart.txFree() >= 24)
+        uart << "line " << (int32_t)lines_left-- << " of the banner\r\n";
 }
 
 int main()
@@ -35,27 +43,32 @@ int main()
     UBRR0H = (uint8_t)(BAUD>>8);    // set baud rate
     UBRR0L = (uint8_t)(BAUD);
     UCSR0C = (1<<UCSZ01)|(1<<UCSZ00);   // asynchronous mode, no parity, 1 stop bit, 8 bit data
-    UCSR0B = (1<<RXEN0)|(1<<TXEN0)|(1<<RXCIE0); // enable receiver and transmitter and receive complete interrupt
+    UCSR0B = (1<<RXEN0)|(1<<TXEN0)|(1<<RXCIE0)|(1<<TXCIE0); // enable receiver and transmitter and their complete interrupts
+    sei();
 
-    uart.onData = [](PipeIO<uart_send_byte>* self, char* prev)  // onData callback of uart receive
+    uart.frameLines('\r');     // onData gets a line at a time, without the '\r' of the enter key
+    uart.dispatchOn(eventloop); // and runs in the eventloop, not in the RX interrupt
+    uart.onData = [](Uart* self, const RxSpan& line)
     {
-        char *buffer = self->buffer();
-        uint8_t length = self->length();
-        for(auto i=prev; i<buffer+length; i++)  // send the content recieved since last time
-        {
-            if(*i == '\0')
-                break;
-            uart_send_byte(*i);
-        }
+        // the line points into the receive ring, split in two when it wraps around, nothing is copied
+        uart << "> ";
+        for(uint8_t i=0; i<line.length(); i++)
+            uart << line[i];
+        uart << "\r\n";
+        if(self->rxDropped())
+            uart << (uint32_t)self->rxDropped() << " bytes dropped so far\r\n";
     };
 
-    uart.onFull = [](PipeIO<uart_send_byte>* self)  // onFull callback of uart recieve
+    uart.onDrain = [](Uart*)    // in the TX interrupt, the ring is empty again
     {
-        uart << "full\r\n";
-        self->buffer_clear();
+        if(lines_left)
+            eventloop.post(printLines);
     };
 
-    // the pipeio supports output streaming operator for some simple types
+    // the pipeio supports output streaming operator for some simple types, none of it waits for the uart
     uart << "Hello world! " << (int32_t)114514 << (float)1919.810 << " " << (void*)uart_send_byte << "\r\n";
+    printLines();
+    while(true)
+        eventloop.runOnce(0);
     return 0;
 }
@@ -8,16 +8,31 @@
 EventLoop<256> eventloop;   // create an eventloop with 256bytes queue
 int64_t Time::s_offset = 0;     // offset to the real time in milliseconds
 
-// timer1 interrupt, interrupt every 1ms
+const EventLoopHelperFunctions helper_functions{
+    nullptr,                    // preQueueProcess
+    nullptr,                    // postQueueProcess
+    nullptr,                    // onTaskAllocationFailed
+    sleepUntilInterrupt,        // idle: sleep between the timeouts instead of spinning
+};
+
+// timer1 interrupt, interrupt every 10ms
 ISR(TIMER1_COMPA_vect, ISR_BLOCK)
 {
     static int cnt = 0;
-    if(cnt >= 1000) // reset cnt every 1000 interrupts
+    if(cnt >= 100)  // reset cnt every 100 interrupts
         cnt = 0;
     cnt++;
-    Time::tick();   // call Time::tick() to update the current time
+    Time::tick(10); // call Time::tick() to update the current time
 }
 
+// the ms and us between two interrupts are read from the counter of timer1
+const TickCounter timer1_counter{
+    [](){ return (uint16_t)TCNT1; },
+    [](){ return (bool)(TIFR1 & (1<<OCF1A)); },
+    CLOCK_FREQ/TIMER_PRESCALER/100,         // counts per tick
+    10000,                                  // us per tick
+};
+
 
 int cancelThis()
 {
@@ -42,11 +57,13 @@ int main()
 {
     Time::absolute();   // init Time singleton
     
-    TCCR1A = 0;                                 // set timer1 interrupt every 1ms
+    TCCR1A = 0;                                 // set timer1 interrupt every 10ms
     TCCR1B = (1<<WGM12)|(1<<CS11)|(1<<CS10);    // CTC mode: clear timer on compare match, pre-scaler=64
-    OCR1A = CLOCK_FREQ/TIMER_PRESCALER/1000;    // compare match register: 1ms
+    OCR1A = CLOCK_FREQ/TIMER_PRESCALER/100 - 1; // compare match register: 10ms, the counter runs 0..OCR1A
+    Time::setTickCounter(&timer1_counter);      // before the interrupt is enabled
     TIMSK1 = (1<<OCIE1A);                       // enable timer compare interrupt by setting bit OCIE1A in TIMSK1
     sei();                                      // enable interrupts
+    eventloop.setHelperFunctions(&helper_functions);
     int a=123, b=324;
     eventloop.setTimeout([=](){
         int c = a+b;
@@ -57,6 +74,9 @@ int main()
     eventloop.setTimeout(cancelThis, 60000);
     eventloop.clearTimeout(cancelThis);  // cancel the timeout task by function poineter
 
+    TaskHandle handle = eventloop.setTimeout(cancelThis, 60000);
+    eventloop.clearTimeout(handle);      // or cancel exactly this one by the handle returned
+
     eventloop.setInterval([=]() mutable {   // supports mutable lambda function as well 
         auto c = a+b;
         a++;
@@ -65,6 +85,8 @@ int main()
 
     eventloop.setTimeout(&Counter::cntpp, 1000, &counter); // and it even supports member function
 
+    eventloop.setTimeoutUs([](){ PORTB ^= (1<<PB5); }, 1500);  // short delays in us, still precise with a 100Hz tick
+
     eventloop.run();    // let the eventloop run!
     // without the help of postQueueProcess, the eventloop will quit after the final timeout task is executed. 
     return 0;
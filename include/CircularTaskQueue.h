@@ -2,74 +2,109 @@
     #define __CircularTaskQueue_H__
 
 #include "Task.h"
+#include "Instrument.h"
 
+/*
+    CircularTaskQueue: tasks of any size stored back to back in a ring of buffer_size bytes.
+    Every task starts on the max alignment of the target (1 on avr, so nothing is wasted there),
+    head, tail and the truncated end are 16-bit offsets into the buffer.
+    m_wrap is where the tasks wrap around: the truncated end after a wrap, buffer_size otherwise,
+    so next() and pop() only compare against it once.
+    A disabled task leaves a tombstone, adjacent tombstones are merged into one dead run, and reclaim() gives the
+    newest run back to the ring right away when it is the tail, instead of waiting for it to reach the head.
+    A queued task never moves while it is in the ring, a pointer to it stays valid until it is popped or disabled.
+*/
 template<std::size_t buffer_size>
 class CircularTaskQueue
 {
+static_assert(buffer_size > 0 && buffer_size < 0xFFFF, "CircularTaskQueue: buffer_size must be in range [1, 65534]");
 private:
-    char m_buffer[buffer_size];
-    char *m_buffer_begin = m_buffer;
-    char *m_buffer_end = nullptr;
-    char *m_begin = nullptr;
-    char *m_end = nullptr;
-    char *m_truncated = nullptr;
-    std::size_t length = 0;
+    alignas(TaskAlignment) char m_buffer[buffer_size];
+    uint16_t m_begin = 0;
+    uint16_t m_end = 0;
+    uint16_t m_wrap = buffer_size;
+    uint16_t length = 0;
+    uint16_t m_last_dead = NoDead;  // start of the newest dead run
+    INSTRUMENT(std::size_t m_bytes_high = 0;)
+    INSTRUMENT(uint32_t m_reclaimed = 0;)
 
+    static constexpr uint16_t NoDead = 0xFFFF;
+
+    static constexpr std::size_t aligned(std::size_t size) { return (size + ALIGNMENT-1) & ~(ALIGNMENT-1); }
+    uint16_t offset(const TaskInterface* ptr) const { return reinterpret_cast<const char*>(ptr) - m_buffer; }
+    TaskInterface* at(uint16_t off) { return reinterpret_cast<TaskInterface*>(m_buffer + off); }
     char* calcAllocAddr(std::size_t size);
 public:
+    static constexpr std::size_t ALIGNMENT = TaskAlignment;
 
     CircularTaskQueue(const CircularTaskQueue<buffer_size> &another) = delete;
-    CircularTaskQueue()
-    {
-        m_buffer_end = m_buffer + buffer_size;
-        m_begin = m_buffer_begin;
-        m_end = m_buffer_begin;
-    }
+    CircularTaskQueue() {}
     ~CircularTaskQueue()
     {
         while(length > 0)   // clear all task
             pop();
     }
-    char* getBufferBegin() { return m_buffer_begin; }
-    char* getBufferEnd() { return m_buffer_end; }
-    char* getTruncated() { return m_truncated; }
+    char* getBufferBegin() { return m_buffer; }
+    char* getBufferEnd() { return m_buffer + buffer_size; }
+    char* getTruncated() { return m_wrap < buffer_size ? m_buffer + m_wrap : nullptr; }
     std::size_t getLength() { return length; }
+    // bytes held by the tasks, the unused tail before a wrap is not counted
+    std::size_t getBytesUsed()
+    {
+        if(length == 0)
+            return 0;
+        if(m_wrap < buffer_size)
+            return (m_wrap - m_begin) + m_end;
+        return m_end - m_begin;
+    }
+    INSTRUMENT(std::size_t getBytesHighWatermark() { return m_bytes_high; })
+    INSTRUMENT(uint32_t getBytesReclaimed() { return m_reclaimed; })
 
-    TaskInterface* begin() { return reinterpret_cast<TaskInterface*>(m_begin); }
-    TaskInterface* end() { return reinterpret_cast<TaskInterface*>(m_end); }
+    TaskInterface* begin() { return at(m_begin); }
+    TaskInterface* end() { return at(m_end); }
     TaskInterface* next(TaskInterface* cur);  
 
     TaskInterface* push(const TaskInterface* ptr);
     TaskInterface* push(const TaskInterface &task) { return push(&task); }
+    // construct a T right in the buffer, nothing is copied
+    template<typename T, typename ...CtorArgs>
+    T* emplace(CtorArgs&&... args);
 
     void pop();
-    void disable(const TaskInterface* ptr);
+    void disable(const TaskInterface* ptr, const TaskInterface* barrier = nullptr);
+    bool reclaim(const TaskInterface* busy, TaskInterface* &follow);
 };
 
 // calculate an available address for a new task, CANNOT be used in ISR
 template<std::size_t buffer_size>
 char* CircularTaskQueue<buffer_size>::calcAllocAddr(std::size_t size)
 {
-    char *addr = nullptr;
-    if(m_begin <= m_end && m_end + size < m_buffer_end)
+    size = aligned(size);
+    if(length == 0)
+    {   // nothing to keep, restart from the buffer begin instead of wrapping around an empty region
+        m_begin = m_end = 0;
+        m_wrap = buffer_size;
+        m_last_dead = NoDead;
+    }
+    const std::size_t end = m_end;
+    if(m_begin <= m_end && end + size < buffer_size)
     {   // [buffer_begin] <-- 0~n --> [begin] <-- 0~n --> [end] <-- {addr} size~n --> [buffer_end]
-        addr = m_end;
-        m_end = addr + size;
+        m_end = end + size;
+        return m_buffer + end;
     }
-    else if(m_begin <= m_end && m_end + size >= m_buffer_end && m_buffer_begin + size < m_begin)
+    else if(m_begin <= m_end && size < m_begin)
     {   // [buffer_begin] <--{addr} size~n --> [begin] <-- 0~n --> [end] <-- 0~size-1 --> [buffer_end]
-        addr = m_buffer_begin;
-        m_truncated = m_end;
-        m_end = addr + size;
+        m_wrap = m_end;
+        m_end = size;
+        return m_buffer;
     }
-    else if(m_begin > m_end && m_end + size < m_begin)
-    {   // [buffer_begin] <-- 0~n --> [end] <-- {addr} size~n --> [begin] <-- 0~n --> [truncated] <-- 0-unused --> [buffer_end]
-        addr = m_end;
-        m_end = addr + size;  
+    else if(m_begin > m_end && end + size < m_begin)
+    {   // [buffer_begin] <-- 0~n --> [end] <-- {addr} size~n --> [begin] <-- 0~n --> [wrap] <-- 0-unused --> [buffer_end]
+        m_end = end + size;
+        return m_buffer + end;
     }
-    else // [buffer_begin] <-- 0~n --> [end] <-- {NOT ENOUGH PLACE} 0~size-1 --> [begin] <-- 0~n --> [truncated] <-- 0~unused --> [buffer_end]
-        return nullptr;
-    return addr;
+    // [buffer_begin] <-- 0~n --> [end] <-- {NOT ENOUGH PLACE} 0~size-1 --> [begin] <-- 0~n --> [wrap] <-- 0~unused --> [buffer_end]
+    return nullptr;
 }
 
 // push a task to the front of the queue
@@ -81,45 +116,107 @@ TaskInterface* CircularTaskQueue<buffer_size>::push(const TaskInterface* ptr)
         return nullptr;
     ptr->copy(addr);
     length++;
+    INSTRUMENT(if(getBytesUsed() > m_bytes_high) m_bytes_high = getBytesUsed();)
     return reinterpret_cast<TaskInterface*>(addr);
 }
 
+template<std::size_t buffer_size>
+template<typename T, typename ...CtorArgs>
+T* CircularTaskQueue<buffer_size>::emplace(CtorArgs&&... args)
+{
+    static_assert(alignof(T) <= ALIGNMENT, "CircularTaskQueue: the task needs a stricter alignment than the queue provides");
+    const auto addr = calcAllocAddr(sizeof(T));
+    if(!addr)
+        return nullptr;
+    auto p = new(addr) T(std::forward<CtorArgs>(args)...);
+    length++;
+    INSTRUMENT(if(getBytesUsed() > m_bytes_high) m_bytes_high = getBytesUsed();)
+    return p;
+}
+
 // pop the element at the back of the queue
 template<std::size_t buffer_size>
 void CircularTaskQueue<buffer_size>::pop() 
 {
     if(length <= 0)
         return;
-    auto todelete = reinterpret_cast<TaskInterface*>(m_begin);
-    std::size_t size = todelete->size();
-    todelete->~TaskInterface(); // NOT using delete here since we constructed it IN PLACE!
-    if(m_truncated != nullptr && m_begin+size >= m_truncated)
-    {   // [buffer_begin] <-- 0~n --> [end] <-- 0~n --> [begin] <-- 0~{size} --> [truncated] <-- 0-unused --> [buffer_end]
-        m_begin = m_buffer_begin;   // skip the trucated region
-        m_truncated = nullptr;
-    }
-    else
-        m_begin = m_begin + size;
+    auto todelete = at(m_begin);
+    if(m_begin == m_last_dead)
+        m_last_dead = NoDead;
+    const std::size_t begin = m_begin + aligned(todelete->size());
+    todelete->destroy();    // NOT using delete here since we constructed it IN PLACE!
+    // reaching the wrap point skips the truncated region, and the ring is whole again
+    const bool wrapped = begin >= m_wrap;
+    m_begin = wrapped ? 0 : begin;
+    m_wrap = wrapped ? buffer_size : m_wrap;
     length--;
 }
 
-// disable a task in the queue, aka erase it
+// disable a task in the queue, aka erase it.
+// the tombstone joins the dead run right before it and swallows the tombstones right after it, a run never grows over barrier,
+// so whoever walks the queue still finds it. every tombstone keeps its own header, a pointer to it stays walkable
 template<std::size_t buffer_size>
-void CircularTaskQueue<buffer_size>::disable(const TaskInterface *ptr)
+void CircularTaskQueue<buffer_size>::disable(const TaskInterface *ptr, const TaskInterface* barrier)
 {
-    const auto size = ptr->size();
-    ptr->~TaskInterface();
+    const uint16_t off = offset(ptr);
+    std::size_t size = aligned(ptr->size());
+    const_cast<TaskInterface*>(ptr)->destroy();
     new((void*)ptr) DisabledTask(size); // in place new a DisableTask replacing the original one
+
+    uint16_t run = off;
+    if(m_last_dead != NoDead && ptr != barrier && m_last_dead + at(m_last_dead)->size() == off
+       && at(m_last_dead)->size() + size <= 0x7FFF)
+    {
+        run = m_last_dead;
+        size += at(run)->size();
+        length--;
+    }
+    for(std::size_t following = run + size; following < m_wrap && following != m_end; following = run + size)
+    {
+        TaskInterface* p = at(following);
+        if(p == barrier || p->type() != TaskType::DISABLED || size + p->size() > 0x7FFF)
+            break;
+        size += p->size();
+        length--;
+    }
+    new(at(run)) DisabledTask(size);
+    m_last_dead = run;
+}
+
+// give the newest dead run back to the ring if it is the tail, no live task is behind it: the tail shrinks by its size.
+// live tasks never move, so the pointers handed out to them stay valid. busy, e.g. the task executing, is never touched.
+// follow is a pointer kept at the end if it was there. false if nothing is reclaimed
+template<std::size_t buffer_size>
+bool CircularTaskQueue<buffer_size>::reclaim(const TaskInterface* busy, TaskInterface* &follow)
+{
+    if(m_last_dead == NoDead || at(m_last_dead) == busy)
+        return false;
+    const uint16_t run = m_last_dead;
+    const uint16_t end = m_end;
+    const std::size_t gap = at(run)->size();
+    if(run + gap != end)
+        return false;
+    if(run == 0 && m_wrap < buffer_size)
+    {   // the run is all there is after a wrap, the truncated tail is handed back too
+        m_end = m_wrap;
+        m_wrap = buffer_size;
+    }
+    else
+        m_end = run;
+    if(follow == at(run) || follow == at(end))
+        follow = this->end();
+    length--;
+    m_last_dead = NoDead;
+    INSTRUMENT(m_reclaimed += gap;)
+    return true;
 }
 
 // return the next TaskInterface's address in the buffer, considered truncated case
 template<std::size_t buffer_size>
 TaskInterface* CircularTaskQueue<buffer_size>::next(TaskInterface* ptr)
 {
-    char* tmp = reinterpret_cast<char*>(ptr) + ptr->size();
-    if(this->getTruncated()!=nullptr && tmp>=this->getTruncated())
-        tmp = this->getBufferBegin();
-    return reinterpret_cast<TaskInterface*>(tmp);
+    const std::size_t off = offset(ptr) + aligned(ptr->size());
+    return at(off >= m_wrap ? 0 : off);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,137 @@
+#ifndef __CIVILTIME_H__
+    #define __CIVILTIME_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <tuple>
+    #include <cstdint>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Time.h"
+
+/*
+    CivilTime: a Time broken down into its calendar fields once, so reading them costs nothing.
+    The accessors of Time redo a chain of 64bit divisions each, software routines of thousands of cycles on avr.
+    Constructing from a Time does one 64bit division and 32bit math for the rest,
+    advance(ms) then walks the fields forward without any division as long as a step is under a minute,
+    e.g. a clock display doing civil.advance(1000) every second. Longer steps break the Time down again.
+*/
+class CivilTime
+{
+private:
+    Time m_time;        // what the fields stand for
+    uint16_t m_year;
+    uint16_t m_yday;    // [0, 365]
+    uint16_t m_ms;      // [0, 999]
+    uint8_t m_month;    // [1, 12]
+    uint8_t m_day;      // [1, 31]
+    uint8_t m_weekday;  // [Sun 0, Sat 6]
+    uint8_t m_hours;
+    uint8_t m_minutes;
+    uint8_t m_seconds;
+
+    static bool isLeap(uint16_t year) { return (year&3) == 0 && (year%100 != 0 || year%400 == 0); }
+    // 31 for 1, 3, 5, 7, 8, 10, 12: odd months up to july, even ones after
+    static uint8_t daysInMonth(uint16_t year, uint8_t month) { return month == 2 ? 28 + isLeap(year) : 30 + ((month + (month>>3)) & 1); }
+
+    void nextDay()
+    {
+        m_weekday = m_weekday == 6 ? 0 : m_weekday+1;
+        m_yday++;
+        if(++m_day <= daysInMonth(m_year, m_month))
+            return;
+        m_day = 1;
+        if(++m_month <= 12)
+            return;
+        m_month = 1;
+        m_year++;
+        m_yday = 0;
+    }
+    // seconds is at most 60 and keeps the fields walking through a minute in one go
+    void addSeconds(uint8_t seconds)
+    {
+        m_seconds += seconds;
+        while(m_seconds >= 60)
+        {
+            m_seconds -= 60;
+            nextMinute();
+        }
+    }
+    void nextMinute()
+    {
+        if(++m_minutes < 60)
+            return;
+        m_minutes = 0;
+        if(++m_hours < 24)
+            return;
+        m_hours = 0;
+        nextDay();
+    }
+public:
+    CivilTime() { set(Time()); }
+    explicit CivilTime(const Time& t) { set(t); }
+
+    // break the time down from scratch. reference: http://howardhinnant.github.io/date_algorithms.html
+    void set(const Time& t)
+    {
+        m_time = t;
+        const uint32_t days = (uint64_t)t/86400000;                         // the only 64bit division
+        uint32_t ms_of_day = (uint64_t)t - (uint64_t)days*86400000;
+        m_hours = ms_of_day/3600000;
+        ms_of_day -= (uint32_t)m_hours*3600000;
+        m_minutes = ms_of_day/60000;
+        const uint16_t ms_of_minute = ms_of_day - (uint32_t)m_minutes*60000;
+        m_seconds = ms_of_minute/1000;
+        m_ms = ms_of_minute - m_seconds*1000u;
+
+        m_weekday = (days+4)%7;                                             // 1970-01-01 was a thursday
+        const uint32_t z = days + 719468;                                   // days since 0000-03-01
+        const uint16_t eras = z/146097;
+        const uint32_t day_of_eras = z - (uint32_t)eras*146097;             // [0, 146096]
+        const uint16_t year_of_eras = (day_of_eras - day_of_eras/1460 + day_of_eras/36524 - day_of_eras/146096)/365; // [0, 399]
+        const uint16_t day_of_year = day_of_eras - (365*(uint32_t)year_of_eras + year_of_eras/4 - year_of_eras/100); // from march 1st [0, 365]
+        const uint8_t month_p = (5*day_of_year + 2)/153;                    // [0, 11] from march
+        m_day = day_of_year - (153*month_p + 2)/5 + 1;
+        m_month = month_p < 10 ? month_p+3 : month_p-9;
+        m_year = year_of_eras + 400*eras + (m_month <= 2);
+        m_yday = m_month <= 2 ? day_of_year - 306 : day_of_year + 59 + isLeap(m_year);
+    }
+
+    // move forward by ms, without dividing when ms is under a minute
+    void advance(uint32_t ms)
+    {
+        m_time = m_time + ms;
+        if(ms >= 60000)
+        {
+            set(m_time);
+            return;
+        }
+        uint16_t left = m_ms + ms;      // < 61000, split into seconds and ms by shift and subtract
+        uint8_t seconds = 0;
+        for(uint8_t bit = 32; bit; bit >>= 1)
+            if(left >= bit*1000u)
+            {
+                left -= bit*1000u;
+                seconds += bit;
+            }
+        m_ms = left;
+        if(seconds)
+            addSeconds(seconds);
+    }
+
+    const Time& time() const { return m_time; }
+    std::tuple<uint16_t, uint8_t, uint8_t> getDate() const { return std::make_tuple(m_year, m_month, m_day); }
+    uint16_t getYear() const { return m_year; }
+    uint8_t getMonth() const { return m_month; }
+    uint8_t getDay() const { return m_day; }
+    uint8_t getWeekday() const { return m_weekday; }
+    uint16_t getDayOfYear() const { return m_yday; }   // [0, 365] from january 1st
+    uint8_t getNthWeek() const { return m_yday/7 + 1; }
+    uint8_t getHours() const { return m_hours; }
+    uint8_t getMinutes() const { return m_minutes; }
+    uint8_t getSeconds() const { return m_seconds; }
+    uint16_t getMillis() const { return m_ms; }
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef __COROUTINE_H__
+    #define __COROUTINE_H__
+
+/*
+    C++20 coroutines on top of EventLoop, nothing here is compiled unless the compiler does coroutines (-std=c++20).
+    A function returning Coroutine<> can co_await:
+    - eventloop.sleep(ms): resumed by a timer of the loop ms later
+    - eventloop.waitEvent(keys[0].onClick): resumed in the pass after the handler slot is exec()'d
+    - eventloop.waitData(pipeio): resumed in the pass after PipeIO::receive() gets a byte in the RX ISR, with an RxSpan of what is unread
+    A suspended coroutine costs the loop one small task holding the address of its frame, nothing more.
+    Frames come from a static pool sized at compile time, one per <frame_count, frame_size>, so there is still no
+    dynamic allocation: a coroutine whose frame is too large or finds the pool empty does not start at all and the
+    Coroutine<> returned is false. largestFrame() of the pool tells how large the frames asked for were.
+    The coroutines are fire and forget, the frame is given back when the body returns. There is no way to cancel
+    one from outside, a wait that can never end (e.g. its handler slot rebound by someone else) keeps its frame.
+*/
+
+#ifdef __cpp_impl_coroutine
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+    #include <cstdlib>
+    #include <coroutine>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Platform.h"
+#include "Task.h"
+
+#ifndef EVENTLOOP_COROUTINE_FRAMES
+    #define EVENTLOOP_COROUTINE_FRAMES 4
+#endif
+#ifndef EVENTLOOP_COROUTINE_FRAME_SIZE
+    #define EVENTLOOP_COROUTINE_FRAME_SIZE (24*sizeof(void*))
+#endif
+
+// fixed frames handed out by a free list, frames never used yet are taken in order so the pool needs no setup
+template<std::size_t frame_count, std::size_t frame_size>
+class CoroutineFramePool
+{
+static_assert(frame_count > 0 && frame_count < 0xFF, "CoroutineFramePool: frame_count must be in range [1, 254]");
+private:
+    union alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Frame
+    {
+        Frame* next;
+        char bytes[frame_size];
+    };
+    Frame m_frames[frame_count];
+    Frame* m_free = nullptr;
+    uint8_t m_fresh = 0;    // frames below it were handed out at least once
+    uint8_t m_used = 0;
+    uint8_t m_failed = 0;
+    std::size_t m_largest = 0;
+public:
+    static constexpr std::size_t FRAME_SIZE = sizeof(Frame);
+
+    void* allocate(std::size_t size)
+    {
+        if(size > m_largest)
+            m_largest = size;
+        Frame* frame = nullptr;
+        if(size <= sizeof(Frame))
+        {
+            if(m_free)
+            {
+                frame = m_free;
+                m_free = frame->next;
+            }
+            else if(m_fresh < frame_count)
+                frame = &m_frames[m_fresh++];
+        }
+        if(!frame)
+        {
+            m_failed++;
+            return nullptr;
+        }
+        m_used++;
+        return frame;
+    }
+    void free(void* p)
+    {
+        Frame* frame = static_cast<Frame*>(p);
+        frame->next = m_free;
+        m_free = frame;
+        m_used--;
+    }
+
+    uint8_t used() const { return m_used; }
+    // coroutines that did not start since the program started, wraps at 256
+    uint8_t failed() const { return m_failed; }
+    // the largest frame asked for, including the ones that did not fit
+    std::size_t largestFrame() const { return m_largest; }
+};
+
+// the one task a suspended coroutine leaves in the loop
+inline void resumeCoroutine(void* frame) { std::coroutine_handle<>::from_address(frame).resume(); }
+
+template<std::size_t frame_count = EVENTLOOP_COROUTINE_FRAMES, std::size_t frame_size = EVENTLOOP_COROUTINE_FRAME_SIZE>
+class Coroutine
+{
+public:
+    using FramePool = CoroutineFramePool<frame_count, frame_size>;
+    static inline FramePool frames;
+
+    struct promise_type
+    {
+        static void* operator new(std::size_t size) noexcept { return frames.allocate(size); }
+        static void operator delete(void* p) noexcept { frames.free(p); }
+        static Coroutine get_return_object_on_allocation_failure() noexcept { return Coroutine(false); }
+        Coroutine get_return_object() noexcept { return Coroutine(true); }
+
+        // runs at once up to the first co_await, the frame is freed as soon as the body returns
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { abort(); }
+    };
+private:
+    bool m_started;
+    explicit Coroutine(bool started) : m_started(started) {}
+public:
+    explicit operator bool() const { return m_started; }
+};
+
+/*
+    The awaitables, got from the loop: co_await eventloop.sleep(ms) and alike.
+    A co_await evaluates to false (an empty RxSpan for waitData) when the loop could not take the wait,
+    the coroutine then goes on at once instead of hanging forever.
+*/
+template<class Loop>
+class CoSleep
+{
+private:
+    Loop& m_loop;
+    uint32_t m_ms;
+    bool m_armed = false;
+public:
+    CoSleep(Loop& loop, uint32_t ms) : m_loop(loop), m_ms(ms) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h) { return m_armed = m_loop.resumeAfter(h.address(), m_ms); }
+    bool await_resume() const noexcept { return m_armed; }
+};
+
+// bound to the handler slot until the coroutine resumes, the handler itself never resumes the coroutine inline
+template<class Loop>
+class CoEvent
+{
+private:
+    Loop& m_loop;
+    TaskInterface*& m_handler;
+    void* m_frame = nullptr;
+    bool m_bound = false;
+    bool m_posted = false;
+
+    // the handler stays bound, so it only schedules the resume once, a full queue is retried on the next exec()
+    static void fire(CoEvent* self)
+    {
+        if(!self->m_posted && self->m_loop.nextTick(resumeCoroutine, self->m_frame))
+            self->m_posted = true;
+    }
+public:
+    CoEvent(Loop& loop, TaskInterface*& event_handler) : m_loop(loop), m_handler(event_handler) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        m_frame = h.address();
+        return m_bound = m_loop.bindEventHandler(m_handler, fire, this);
+    }
+    bool await_resume()
+    {
+        if(m_bound)
+            m_loop.clearEventHandler(m_handler);
+        return m_bound;
+    }
+};
+
+// the onDataEvent slot of a PipeIO, exec()'d by receive() in the RX ISR on every byte.
+// so it is bound and cleared in a critical section, and resumes through post(): that ISR must be the only one posting
+template<class Loop, class Pipe>
+class CoData
+{
+private:
+    Loop& m_loop;
+    Pipe& m_pipe;
+    void* m_frame = nullptr;
+    bool m_bound = false;
+    volatile bool m_posted = false;
+
+    // a full injection queue is retried on the next data
+    static void fire(CoData* self)
+    {
+        if(!self->m_posted && self->m_loop.post(resumeCoroutine, self->m_frame))
+            self->m_posted = true;
+    }
+public:
+    CoData(Loop& loop, Pipe& pipe) : m_loop(loop), m_pipe(pipe) {}
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        m_frame = h.address();
+        CriticalSection cs;
+        return m_bound = m_loop.bindEventHandler(m_pipe.onDataEvent, fire, this);
+    }
+    // everything not consumed yet, pipe.rxConsume() what has been used
+    RxSpan await_resume()
+    {
+        if(!m_bound)
+            return RxSpan();
+        CriticalSection cs;
+        m_loop.clearEventHandler(m_pipe.onDataEvent);
+        return m_pipe.rxPeek();
+    }
+};
+
+#endif
+
+#endif
@@ -13,37 +13,201 @@
 #include "Time.h"
 #include "Task.h"
 #include "CircularTaskQueue.h"
+#include "TaskPool.h"
+#include "TimerWheel.h"
+#include "InjectionQueue.h"
+#include "Instrument.h"
+#include "Coroutine.h"
 
 struct EventLoopHelperFunctions
 {
     EventLoopHelperFunctions(
         uint8_t (*_preQueueProcess)(uint16_t) = nullptr, 
         uint8_t (*_postQueueProcess)(uint16_t) = nullptr,
-        void (*_onTaskAllocationFailed)(void*) = nullptr 
+        void (*_onTaskAllocationFailed)(void*) = nullptr,
+        void (*_idle)(uint32_t, const volatile uint8_t&) = nullptr
     ) : preQueueProcess(_preQueueProcess),
         postQueueProcess(_postQueueProcess),
-        onTaskAllocationFailed(_onTaskAllocationFailed)
+        onTaskAllocationFailed(_onTaskAllocationFailed),
+        idle(_idle)
     {}
 
     uint8_t (*preQueueProcess)(uint16_t) = nullptr;
     uint8_t (*postQueueProcess)(uint16_t) = nullptr;
     void (*onTaskAllocationFailed)(void*) = nullptr;
+    // called by run() when nothing is due, with the ms until the earliest deadline (NoDeadline if none).
+    // It may return early, and it MUST return soon after the wakeup flag becomes non-zero
+    void (*idle)(uint32_t, const volatile uint8_t&) = nullptr;
 };
 
-template<std::size_t taskbuf_size=768>
+struct EventLoopIdleStats
+{
+    uint32_t iterations = 0;    // runOnce() calls
+    uint32_t wakeups = 0;       // returns from the idle hook
+    uint32_t idle_ms = 0;       // time spent inside the idle hook
+};
+
+/*
+    TaskHandle: refers to a timeout or interval task kept by EventLoop, returned by setTimeout() and alike.
+    It is an index to the handle table of the loop plus the generation of that entry,
+    so a handle outlived its task is detected, until the same entry has been reused 256 times.
+*/
+struct TaskHandle
+{
+    uint8_t index = 0xFF;
+    uint8_t generation = 0;
+    
+    explicit operator bool() const { return index != 0xFF; }
+    bool operator==(const TaskHandle& another) const { return index == another.index && generation == another.generation; }
+    bool operator!=(const TaskHandle& another) const { return !(*this == another); }
+};
+
+/*
+    TimerSlack: how much later than asked a timer may fire, for setTimeout() and setInterval().
+    The timer is due at its time as usual and fires in the first pass from then on, but nextDeadline() and so the idle
+    hook only wake up for it at the latest point of its window, rounded down to a power of 2 ms shared with other timers.
+    Timers that do not need the precision then ride on the wakeups of other timers, or share one of their own.
+    Only resident timers get slack, a timer that falls back to the queue fires on time.
+*/
+struct TimerSlack
+{
+    uint16_t ms;
+    explicit TimerSlack(uint16_t slack_ms) : ms(slack_ms) {}
+};
+
+/*
+    EventLoop: taskbuf_size bytes of CircularTaskQueue for the tasks,
+    plus resident_slots slots of resident_slot_size bytes for the long-lived tasks: timeouts, intervals and event handlers.
+    A resident task is constructed once in its slot and runs there, timeouts and intervals are indexed by the TimerWheel.
+    A task too large for a slot, or created when all slots are taken, falls back to the queue.
+    handle_slots timeout or interval tasks can be referred by TaskHandle at the same time,
+    tasks scheduled when the handle table is full still run, but get an empty handle.
+    inject_slots tasks of at most resident_slot_size bytes can wait in the injection queue, posted by post() from ISRs.
+*/
+template<std::size_t taskbuf_size=768, std::size_t resident_slots=8, std::size_t resident_slot_size=8*sizeof(void*), std::size_t handle_slots=16, std::size_t inject_slots=4>
 class EventLoop
 {
+static_assert(handle_slots < 0xFF, "EventLoop: handle_slots must be less than 255");
 private:
+    // the entries are keepers of the tasks, they follow the tasks moving in the queue and reset when the tasks are gone
+    TaskInterface* m_handles[handle_slots ? handle_slots : 1] = {nullptr};
+    uint8_t m_generations[handle_slots ? handle_slots : 1] = {0};
+    uint8_t m_handle_cursor = 0;
     CircularTaskQueue<taskbuf_size> m_task_queue;
     TaskInterface* m_cur_begin;
     TaskInterface* m_delimiter;
     TaskInterface* m_next_end;
+    TaskInterface* m_sweeping = nullptr;    // the queued task runCurrentQueue() is at, it stays where it is until popped
+    TaskPool<resident_slots, resident_slot_size> m_resident_pool;
+    TimerWheel<resident_slots> m_timer_wheel;
+    SlotIndex m_running = NoSlot;   // the resident timer executing, disabling it is delayed until it returns
+    bool m_running_cleared = false; // the running timer has been disabled, runTimers() destroys it once it returns
+    uint8_t m_cleared_events = 0;   // resident event handlers cleared while they were firing, left to the next pass
+    InjectionQueue<inject_slots, resident_slot_size> m_injected;
 
     const EventLoopHelperFunctions* m_helper_functions;
-    void runCurrentQueue(int16_t passed_ms);
+    PlatformWakeup m_wakeup;        // set from other contexts
+    EventLoopIdleStats m_idle_stats;
+    INSTRUMENT(EventLoopStats m_stats;)
+
+    void runCurrentQueue(uint32_t passed_ms);
+    void destroyClearedEvents();
+    void runTimers(uint32_t passed_ms);
+    void drainInjected();
+    // push to the queue, an empty queue restarts from the buffer begin, so the pass pointers follow it
+    TaskInterface* pushQueue(const TaskInterface* ptr)
+    {
+        const bool was_empty = m_task_queue.getLength() == 0;
+        return queued(m_task_queue.push(ptr), was_empty);
+    }
+    template<typename T, typename ...CtorArgs>
+    TaskInterface* emplaceQueue(CtorArgs&&... args)
+    {
+        const bool was_empty = m_task_queue.getLength() == 0;
+        return queued(m_task_queue.template emplace<T>(std::forward<CtorArgs>(args)...), was_empty);
+    }
+    TaskInterface* queued(TaskInterface* p, bool was_empty)
+    {
+        if(p && was_empty)
+            m_cur_begin = m_delimiter = p;
+        m_next_end = m_task_queue.end();
+        return p;
+    }
+    // hand the newest dead run back to the ring if it is the tail, the pass pointers follow the end
+    void reclaimQueue()
+    {
+        if(!m_task_queue.reclaim(m_sweeping, m_delimiter))
+            return;
+        m_cur_begin = m_task_queue.begin();
+        m_next_end = m_task_queue.end();
+    }
+    TaskInterface* pushResident(const TaskInterface* ptr);
+    template<typename T, typename ...CtorArgs>
+    TaskInterface* emplaceResident(CtorArgs&&... args)
+    {
+        const SlotIndex i = m_resident_pool.template emplace<T>(std::forward<CtorArgs>(args)...);
+        if(i == NoSlot)
+            return emplaceQueue<T>(std::forward<CtorArgs>(args)...);
+        INSTRUMENT(if(m_resident_pool.used() > m_stats.resident_high) m_stats.resident_high = m_resident_pool.used();)
+        return m_resident_pool.at(i);
+    }
+    // a timer placed in the pool is indexed by the wheel, one in the queue counts down there
+    TaskInterface* armTimer(TaskInterface* p, uint32_t ms, uint16_t slack = 0)
+    {
+        if(p && m_resident_pool.contains(p))
+            m_timer_wheel.insert(m_resident_pool.indexOf(p), ms, slack);
+        return p;
+    }
+    void allocationFailed(void* faddr)
+    {
+        INSTRUMENT(m_stats.alloc_failures++;)
+        if(m_helper_functions && m_helper_functions->onTaskAllocationFailed)
+            m_helper_functions->onTaskAllocationFailed(faddr);
+    }
+    // every task the loop runs goes through here, the type is taken before exec() since a task may disable itself
+    void execute(TaskInterface* p)
+    {
+#ifdef EVENTLOOP_INSTRUMENT
+        const TaskType type = p->type();
+        void* const faddr = p->faddr();
+        const uint32_t begin = instrumentClockUs();
+        p->exec();
+        m_stats.recordExec(faddr, type, instrumentClockUs()-begin);
+#else
+        p->exec();
+#endif
+    }
+    TaskInterface* pushTimer(const TaskInterface* ptr, uint32_t ms, uint16_t slack = 0);
+    TaskInterface* findResident(void* faddr, TaskType type);
+    template<typename Callable>
+    TaskInterface* armTimeout(const Task<Callable>& task, uint32_t ms, const Time& when, uint16_t slack = 0);
+    template<typename Callable>
+    TaskInterface* armInterval(const Task<Callable>& task, uint16_t ms, uint16_t slack);
+    TaskHandle bindHandle(TaskInterface* task);
+    // move the task to the next queue, its keeper follows
+    void requeue(TaskInterface* task)
+    {
+        auto next = nextTick(task);
+        if(next)
+            next->updateKeeper();
+    }
+    TaskInterface* resolve(TaskHandle handle) const
+    {
+        if(handle.index >= handle_slots || m_generations[handle.index] != handle.generation)
+            return nullptr;
+        TaskInterface* p = m_handles[handle.index];
+        return p && isCleared(p) ? nullptr : p;
+    }
+    // the timer executing right now has already been disabled
+    bool isCleared(const TaskInterface* p) const
+    { return m_running_cleared && m_resident_pool.contains(p) && m_resident_pool.indexOf(p) == m_running; }
 
 public:
     static constexpr std::size_t TASK_BUFFER_SIZE = taskbuf_size;
+    static constexpr std::size_t RESIDENT_SLOTS = resident_slots;
+    static constexpr std::size_t RESIDENT_SLOT_SIZE = resident_slot_size;
+    static constexpr std::size_t HANDLE_SLOTS = handle_slots;
+    static constexpr std::size_t INJECT_SLOTS = inject_slots;
 
     EventLoop(EventLoopHelperFunctions* helper_functions=nullptr) : 
     m_task_queue(),
@@ -62,9 +226,50 @@ public:
     TaskInterface* __debugGetCurBegin() { return m_cur_begin; }
     TaskInterface* __debugGetDelimiter() { return m_delimiter; }
     TaskInterface* __debugGetNextEnd() { return m_next_end; }
+    TaskPool<resident_slots, resident_slot_size>* __debugGetResidentPool() { return &m_resident_pool; }
+    TimerWheel<resident_slots>* __debugGetTimerWheel() { return &m_timer_wheel; }
 
     TaskInterface* nextTick(const TaskInterface* ptr);
 
+    // the ISR-safe nextTick(), the task runs in the next pass of the loop; false if the injection queue is full.
+    // Only ONE producer context may post, e.g. ISRs that do not nest
+    bool post(const TaskInterface* ptr)
+    {
+        const bool ok = m_injected.push(ptr);
+        wakeup();
+        return ok;
+    }
+    template<typename Callable>
+    bool post(const Task<Callable>& task) { return post(&task); }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    bool post(Callable callable, Args... args)
+    { return post(make_task(callable).setArgs({args...})); }
+
+    // the ISR-safe setTimeout(), no handle is returned
+    template<typename Callable>
+    bool postTimeout(const Task<Callable>& task, uint16_t ms)
+    {
+        auto timeout = task.template transform<TimeoutTask>();
+        timeout.setTimeLeft(ms);
+        return post(&timeout);
+    }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    bool postTimeout(Callable callable, uint16_t ms, Args... args)
+    { return postTimeout(make_task(callable).setArgs({args...}), ms); }
+    // tasks rejected by post() and postTimeout(), wraps at 256
+    uint8_t droppedPosts() const { return m_injected.dropped(); }
+    // take over a task built somewhere else, e.g. posted or sent from another loop: a timeout counts down from now,
+    // anything else runs in the next pass. NOT ISR-safe, the loop's own context only
+    TaskInterface* accept(const TaskInterface* ptr)
+    {
+        if(ptr->type() != TaskType::TIMEOUT)
+            return nextTick(ptr);
+        auto p = pushTimer(ptr, ptr->getTimeLeft());
+        if(!p)
+            allocationFailed(ptr->faddr());
+        return p;
+    }
+
     template<typename Callable>
     TaskInterface* nextTick(const Task<Callable>& task) { return nextTick(&task); }
 
@@ -73,43 +278,93 @@ public:
     { return nextTick(make_task(callable).setArgs({args...})); }
     
 
+    // the emplace functions construct the final task right in its slot or in the queue, nothing is copied on the way,
+    // the arguments are forwarded, so move-only callables and arguments work as long as the task runs only once
+    template<typename Callable, typename ...Args>
+    TaskInterface* emplaceTick(Callable callable, Args&&... args);
+    template<typename Callable, typename ...Args>
+    TaskHandle emplaceTimeout(Callable callable, uint32_t ms, Args&&... args);
+    template<typename Callable, typename ...Args>
+    TaskHandle emplaceInterval(Callable callable, uint16_t ms, Args&&... args);
+
     template<typename Callable>
-    TaskInterface* setTimeout(const Task<Callable>& task, uint32_t ms);
+    TaskHandle setTimeout(const Task<Callable>& task, uint32_t ms);
     
     template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
-    TaskInterface* setTimeout(Callable callable, uint32_t ms, Args... args) 
+    TaskHandle setTimeout(Callable callable, uint32_t ms, Args... args) 
     { return setTimeout(make_task(callable).setArgs({args...}), ms); }
 
-    void disableTask(TaskInterface* task)
-    { m_task_queue.disable(task); }
+    // the same, fired up to slack ms late together with other timers, see TimerSlack
+    template<typename Callable>
+    TaskHandle setTimeout(const Task<Callable>& task, uint32_t ms, TimerSlack slack)
+    { return bindHandle(armTimeout(task, ms, ms < 0xFFFF ? Time() : Time(Time::absolute()+ms), slack.ms)); }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    TaskHandle setTimeout(Callable callable, uint32_t ms, TimerSlack slack, Args... args)
+    { return setTimeout(make_task(callable).setArgs({args...}), ms, slack); }
+
+    // a timeout in us for short delays, up to ~35 minutes: run in the first pass after Time::micros() reaches it.
+    // the wheel waits out the whole ms, the rest is polled pass by pass without sleeping, so it is as precise
+    // as the passes are short. with a TickCounter that holds whatever rate the tick ISR runs at
+    template<typename Callable>
+    TaskHandle setTimeoutUs(const Task<Callable>& task, uint32_t us);
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    TaskHandle setTimeoutUs(Callable callable, uint32_t us, Args... args)
+    { return setTimeoutUs(make_task(callable).setArgs({args...}), us); }
+
+    void disableTask(TaskInterface* task);
 
+    // O(1), only the task that the handle refers to is cleared
+    void clearTimeout(TaskHandle handle)
+    { if(auto p = findTimeout(handle)) disableTask(p); }
+    // clears EVERY timeout task of the function
     void clearTimeout(void* faddr);
     template<typename Callable>
     void clearTimeout(Callable callable)
     { clearTimeout(TaskInterface::extract_raw_function_pointer(callable)); }
 
     template<typename Callable>
-    TaskInterface* scheduleTimeout(const Task<Callable>& task, const Time& when);
+    TaskHandle scheduleTimeout(const Task<Callable>& task, const Time& when);
     template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
-    TaskInterface* scheduleTimeout(Callable callable, const Time& when, Args... args) 
+    TaskHandle scheduleTimeout(Callable callable, const Time& when, Args... args) 
     { return scheduleTimeout(make_task(callable).setArgs({args...}), when); }
 
+    // O(1), nullptr if the task has run or been cleared
+    TaskInterface* findTimeout(TaskHandle handle)
+    {
+        auto p = resolve(handle);
+        return p && isTimeout(p->type()) ? p : nullptr;
+    }
     TaskInterface* findTimeout(void* addr);
     template<typename Ret, typename ...Args>
     TaskInterface* findTimeout(Ret func(Args...))
     { return findTimeout(reinterpret_cast<void*>(func)); }
 
     template<typename Callable>
-    TaskInterface* setInterval(const Task<Callable>& task, uint16_t ms);
+    TaskHandle setInterval(const Task<Callable>& task, uint16_t ms)
+    { return bindHandle(armInterval(task, ms, 0)); }
     template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
-    TaskInterface* setInterval(Callable callable, uint16_t ms, Args... args) 
+    TaskHandle setInterval(Callable callable, uint16_t ms, Args... args) 
     { return setInterval(make_task(callable).setArgs({args...}), ms); }
+    // every period fires up to slack ms late, on the boundaries shared with other timers, see TimerSlack
+    template<typename Callable>
+    TaskHandle setInterval(const Task<Callable>& task, uint16_t ms, TimerSlack slack)
+    { return bindHandle(armInterval(task, ms, slack.ms)); }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    TaskHandle setInterval(Callable callable, uint16_t ms, TimerSlack slack, Args... args)
+    { return setInterval(make_task(callable).setArgs({args...}), ms, slack); }
 
+    void clearInterval(TaskHandle handle)
+    { if(auto p = findInterval(handle)) disableTask(p); }
     void clearInterval(void* faddr);
     template<typename Callable>
     void clearInterval(Callable callable)
     { clearInterval(TaskInterface::extract_raw_function_pointer(callable)); }
 
+    TaskInterface* findInterval(TaskHandle handle)
+    {
+        auto p = resolve(handle);
+        return p && p->type() == TaskType::INTERVAL ? p : nullptr;
+    }
     TaskInterface* findInterval(void* addr);
     template<typename Ret, typename ...Args>
     TaskInterface* findInterval(Ret func(Args...))
@@ -126,9 +381,39 @@ public:
 
     void clearEventHandler(TaskInterface* &taskptr);
 
-    uint8_t runOnce(int16_t passed_ms)
+#ifdef __cpp_impl_coroutine
+    // co_await these in a Coroutine<>, see Coroutine.h
+    CoSleep<EventLoop> sleep(uint32_t ms) { return CoSleep<EventLoop>(*this, ms); }
+    CoEvent<EventLoop> waitEvent(TaskInterface* &event_handler) { return CoEvent<EventLoop>(*this, event_handler); }
+    template<typename Pipe>
+    CoData<EventLoop, Pipe> waitData(Pipe& pipe) { return CoData<EventLoop, Pipe>(*this, pipe); }
+    // the timer behind sleep(), it takes no handle so a full handle table does not matter
+    TaskInterface* resumeAfter(void* frame, uint32_t ms)
+    { return armTimeout(make_task(resumeCoroutine).setArgs({frame}), ms, ms < 0xFFFF ? Time() : Time(Time::absolute()+ms)); }
+#endif
+
+    // ms until the earliest pending deadline, 0 if some task can run now, NoDeadline if there is no deadline at all
+    uint32_t nextDeadline();
+    // cut the idle hook short, can be called in ISR
+    void wakeup() { m_wakeup.set(); }
+    const EventLoopIdleStats& idleStats() const { return m_idle_stats; }
+#ifdef EVENTLOOP_INSTRUMENT
+    EventLoopStats stats()
+    {
+        m_stats.queue_bytes_high = m_task_queue.getBytesHighWatermark();
+        m_stats.reclaimed_bytes = m_task_queue.getBytesReclaimed();
+        m_stats.queue_bytes_capacity = taskbuf_size;
+        m_stats.resident_capacity = resident_slots;
+        return m_stats;
+    }
+    void resetStats() { m_stats = EventLoopStats(); }
+#endif
+
+    uint8_t runOnce(uint32_t passed_ms)
     {
         uint8_t status = 0;
+        m_idle_stats.iterations++;
+        drainInjected();
         if(m_helper_functions && m_helper_functions->preQueueProcess)
             status = m_helper_functions->preQueueProcess(m_task_queue.getLength());
         runCurrentQueue(passed_ms);
@@ -136,208 +421,404 @@ public:
             status = m_helper_functions->postQueueProcess(m_task_queue.getLength());
         return status;
     }
+    bool hasPendingTasks() const
+    { return m_cur_begin != m_next_end || m_resident_pool.used() || !m_injected.empty(); }
     void run()
     {
-        Time prev = Time::absolute();
-        while (m_cur_begin != m_next_end)
+        ShortTime prev = Time::absoluteShort();
+        while (hasPendingTasks())
         {
-            Time now = Time::absolute();
+            ShortTime now = Time::absoluteShort();
             runOnce(now-prev);
             prev = now;
+            if(m_helper_functions && m_helper_functions->idle && hasPendingTasks())    // never sleep on an empty loop, it is about to exit
+                idle();
         }
     };
+    void idle();
 };
 
 // execute the task in the next queue
-template<std::size_t taskbuf_size>
-TaskInterface* EventLoop<taskbuf_size>::nextTick(const TaskInterface* ptr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::nextTick(const TaskInterface* ptr)
 {
-    auto p = m_task_queue.push(ptr);
-    m_next_end = m_task_queue.end();
-    if(!p && m_helper_functions && m_helper_functions->onTaskAllocationFailed)
-        m_helper_functions->onTaskAllocationFailed(ptr->faddr());
+    auto p = pushQueue(ptr);
+    if(!p)
+        allocationFailed(ptr->faddr());
     return p;
 }
 
 // delay a task for ms milliseconds
-template<std::size_t taskbuf_size>
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+template<typename Callable>
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::setTimeout(const Task<Callable>& task, uint32_t ms)
+{
+    return bindHandle(armTimeout(task, ms, ms < 0xFFFF ? Time() : Time(Time::absolute()+ms)));
+}
+
+// the wheel is armed for the whole ms only, so the task comes up at or before its deadline
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
 template<typename Callable>
-TaskInterface* EventLoop<taskbuf_size>::setTimeout(const Task<Callable>& task, uint32_t ms)
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::setTimeoutUs(const Task<Callable>& task, uint32_t us)
+{
+    if(us > 0x7FFFFFFF)
+        us = 0x7FFFFFFF;
+    auto timeout = task.template transform<MicroTimeoutTask>();
+    timeout.setDeadlineUs(Time::micros() + us);
+    auto p = pushTimer(&timeout, us/1000);
+    if(!p)
+        allocationFailed(task.faddr());
+    return bindHandle(p);
+}
+
+// take a free entry of the handle table for the task, the cursor rotates so the generations wear evenly
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::bindHandle(TaskInterface* task)
 {
+    TaskHandle handle;
+    if(!task)
+        return handle;
+    for(uint8_t n=0; n<handle_slots; n++)
+    {
+        const uint8_t i = m_handle_cursor;
+        m_handle_cursor = (std::size_t)(i+1) < handle_slots ? i+1 : 0;
+        if(m_handles[i])
+            continue;
+        m_handles[i] = task;
+        task->setKeeper(&m_handles[i]);
+        handle.index = i;
+        handle.generation = ++m_generations[i];
+        break;
+    }
+    return handle;
+}
+
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+template<typename Callable, typename ...Args>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::emplaceTick(Callable callable, Args&&... args)
+{
+    void* const faddr = TaskInterface::extract_raw_function_pointer(callable);
+    auto p = emplaceQueue<Task<Callable>>(task_impl::EmplaceTag(), std::move(callable), std::forward<Args>(args)...);
+    if(!p)
+        allocationFailed(faddr);
+    return p;
+}
+
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+template<typename Callable, typename ...Args>
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::emplaceTimeout(Callable callable, uint32_t ms, Args&&... args)
+{
+    void* const faddr = TaskInterface::extract_raw_function_pointer(callable);
+    if(ms > TimerWheel<resident_slots>::MAX_DELAY)
+        ms = TimerWheel<resident_slots>::MAX_DELAY;
     TaskInterface *p = nullptr;
     if(ms < 0xFFFF)
     {
-        p = m_task_queue.push(task.template transform<TimeoutTask>());
+        p = emplaceResident<TimeoutTask<Callable>>(task_impl::EmplaceTag(), std::move(callable), std::forward<Args>(args)...);
         if(p)
             p->setTimeLeft(ms);
     }
-    else 
+    else
     {
-        p = m_task_queue.push(task.template transform<LongTimeoutTask>());
+        p = emplaceResident<LongTimeoutTask<Callable>>(task_impl::EmplaceTag(), std::move(callable), std::forward<Args>(args)...);
         if(p)
             p->setScheduleTime(Time::absolute()+ms);
     }
-    m_next_end = m_task_queue.end();
-    if(!p && m_helper_functions && m_helper_functions->onTaskAllocationFailed)
-        m_helper_functions->onTaskAllocationFailed(task.faddr());
+    if(!p)
+        allocationFailed(faddr);
+    return bindHandle(armTimer(p, ms));
+}
+
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+template<typename Callable, typename ...Args>
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::emplaceInterval(Callable callable, uint16_t ms, Args&&... args)
+{
+    void* const faddr = TaskInterface::extract_raw_function_pointer(callable);
+    auto p = emplaceResident<IntervalTask<Callable>>(task_impl::EmplaceTag(), std::move(callable), std::forward<Args>(args)...);
+    if(p)
+    {
+        p->setTimeLeft(ms);
+        p->setInterval(ms);
+    }
+    else
+        allocationFailed(faddr);
+    return bindHandle(armTimer(p, ms));
+}
+
+// arm a timeout task, the LongTimeoutTask<> keeps the absolute schedule time when
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+template<typename Callable>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::armTimeout(const Task<Callable>& task, uint32_t ms, const Time& when, uint16_t slack)
+{
+    TaskInterface *p = nullptr;
+    if(ms < 0xFFFF)
+    {
+        auto timeout = task.template transform<TimeoutTask>();
+        timeout.setTimeLeft(ms);
+        p = pushTimer(&timeout, ms, slack);
+    }
+    else 
+    {
+        auto timeout = task.template transform<LongTimeoutTask>();
+        timeout.setScheduleTime(when);
+        p = pushTimer(&timeout, ms, slack);
+    }
+    if(!p)
+        allocationFailed(task.faddr());
     return p;
 }
 
+// construct the task in a resident slot, the queue is used when it does not fit
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::pushResident(const TaskInterface* ptr)
+{
+    const SlotIndex i = m_resident_pool.construct(ptr);
+    if(i != NoSlot)
+    {
+        INSTRUMENT(if(m_resident_pool.used() > m_stats.resident_high) m_stats.resident_high = m_resident_pool.used();)
+        return m_resident_pool.at(i);
+    }
+    return pushQueue(ptr);
+}
+
+// a resident timer is also indexed by the wheel, one in the queue counts down there
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::pushTimer(const TaskInterface* ptr, uint32_t ms, uint16_t slack)
+{
+    return armTimer(pushResident(ptr), ms, slack);
+}
+
+// disable a task wherever it is stored
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::disableTask(TaskInterface* task)
+{
+    if(task->isFiring())
+    {   // an event handler clearing itself, or cleared by an ISR that interrupted it: its exec() is still running
+        task->setCleared();
+        task->setKeeper(nullptr);   // a requeue must not point the keeper back at it
+        if(m_resident_pool.contains(task))
+            m_cleared_events++;
+        return;     // runCurrentQueue() drops it once exec() has returned
+    }
+    if(!m_resident_pool.contains(task))
+    {
+        m_task_queue.disable(task, m_delimiter);
+        return reclaimQueue();
+    }
+    const SlotIndex i = m_resident_pool.indexOf(task);
+    if(i == m_running)
+        m_running_cleared = true;   // runTimers() destroys it after it returns
+    else
+    {
+        m_timer_wheel.remove(i);
+        m_resident_pool.destroy(i);
+    }
+}
+
+// find the first resident task of the function with the type, TIMEOUT stands for every kind of timeout
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::findResident(void* faddr, TaskType type)
+{
+    for(SlotIndex i=0; i<resident_slots; i++)
+    {
+        if(!m_resident_pool.isBusy(i) || (i == m_running && m_running_cleared) || m_resident_pool.at(i)->isCleared())
+            continue;
+        TaskInterface* p = m_resident_pool.at(i);
+        if((type == TaskType::TIMEOUT ? isTimeout(p->type()) : p->type() == type) && p->faddr() == faddr)
+            return p;
+    }
+    return nullptr;
+}
+
 // clear the timeout task by the function pointer
-template<std::size_t taskbuf_size>
-void EventLoop<taskbuf_size>::clearTimeout(void* faddr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::clearTimeout(void* faddr)
 {
+    while(TaskInterface* p = findResident(faddr, TaskType::TIMEOUT))
+        disableTask(p);
     // when runOnce() iterating current task queue, the timeout task iterated will be move to
     // the next queue. So the specified timeout task will exist once after where the clearTimeout() 
     // called, which is m_cur_begin.
     for(TaskInterface* ptr = m_cur_begin; ptr != m_next_end; ptr = m_task_queue.next(ptr))
-        if((ptr->type() == TaskType::TIMEOUT || ptr->type() == TaskType::LONGTIMEOUT ) && ptr->faddr() == faddr)    
-            m_task_queue.disable(ptr);
+        if(isTimeout(ptr->type()) && ptr->faddr() == faddr)
+            m_task_queue.disable(ptr, m_delimiter);
+    reclaimQueue();
 }
 
 // find the timeout task by the function pointer, if not found, return nullptr
-template<std::size_t taskbuf_size>
-TaskInterface* EventLoop<taskbuf_size>::findTimeout(void* addr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::findTimeout(void* addr)
 {
+    if(TaskInterface* p = findResident(addr, TaskType::TIMEOUT))
+        return p;
     for(TaskInterface* ptr = m_cur_begin; ptr != m_next_end; ptr = m_task_queue.next(ptr))
-        if((ptr->type() == TaskType::TIMEOUT || ptr->type() == TaskType::LONGTIMEOUT ) && ptr->faddr() == addr)    
+        if(isTimeout(ptr->type()) && ptr->faddr() == addr)
             return ptr;
     return nullptr;
 }
 
-template<std::size_t taskbuf_size>
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
 template<typename Callable>
-TaskInterface* EventLoop<taskbuf_size>::scheduleTimeout(const Task<Callable>& task, const Time& when)
+TaskHandle EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::scheduleTimeout(const Task<Callable>& task, const Time& when)
 {
-    TaskInterface *p = nullptr;
     long long diff = when-Time::absolute();
     if(diff < 0)
-        return nextTick(task);  // run missed task next tick
-    if(diff < 0xFFFF)
-    {
-        p = m_task_queue.push(task.template transform<TimeoutTask>());
-        if(p)
-            p->setTimeLeft(diff);
-    }
-    else 
-    {
-        p = m_task_queue.push(task.template transform<LongTimeoutTask>());
-        if(p)
-            p->setScheduleTime(when);
-    }
-    m_next_end = m_task_queue.end();
-    if(!p && m_helper_functions && m_helper_functions->onTaskAllocationFailed)
-        m_helper_functions->onTaskAllocationFailed(task.faddr());
-    return p;
+        diff = 0;   // run missed task next tick
+    return bindHandle(armTimeout(task, diff < TimerWheel<resident_slots>::MAX_DELAY ? diff : TimerWheel<resident_slots>::MAX_DELAY, when));
 }
 
-template<std::size_t taskbuf_size>
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
 template<typename Callable>
-TaskInterface* EventLoop<taskbuf_size>::setInterval(const Task<Callable>& task, uint16_t ms)
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::armInterval(const Task<Callable>& task, uint16_t ms, uint16_t slack)
 {
-    TaskInterface *p = nullptr;
-    p = m_task_queue.push(task.template transform<IntervalTask>());
-    if(p)
-    {
-        p->setTimeLeft(ms);
-        p->setInterval(ms);
-    }
-    m_next_end = m_task_queue.end();
-    if(!p && m_helper_functions && m_helper_functions->onTaskAllocationFailed)
-        m_helper_functions->onTaskAllocationFailed(task.faddr());
+    auto interval = task.template transform<IntervalTask>();
+    interval.setTimeLeft(ms);
+    interval.setInterval(ms);
+    auto p = pushTimer(&interval, ms, slack);
+    if(!p)
+        allocationFailed(task.faddr());
     return p;
 }
 
-template<std::size_t taskbuf_size>
-void EventLoop<taskbuf_size>::clearInterval(void* faddr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::clearInterval(void* faddr)
 {
+    while(TaskInterface* p = findResident(faddr, TaskType::INTERVAL))
+        disableTask(p);
     for(TaskInterface* ptr = m_cur_begin; ptr != m_next_end; ptr = m_task_queue.next(ptr))
         if((ptr->type() == TaskType::INTERVAL) && ptr->faddr() == faddr)    
-            m_task_queue.disable(ptr);
+            m_task_queue.disable(ptr, m_delimiter);
+    reclaimQueue();
 }
 
-template<std::size_t taskbuf_size>
-TaskInterface* EventLoop<taskbuf_size>::findInterval(void* faddr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::findInterval(void* faddr)
 {
+    if(TaskInterface* p = findResident(faddr, TaskType::INTERVAL))
+        return p;
     for(TaskInterface* ptr = m_cur_begin; ptr != m_next_end; ptr = m_task_queue.next(ptr))
         if((ptr->type() == TaskType::INTERVAL) && ptr->faddr() == faddr)    
             return ptr;
     return nullptr;
 }
 
-template<std::size_t taskbuf_size>
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
 template<typename Callable>
-TaskInterface* EventLoop<taskbuf_size>::bindEventHandler(TaskInterface* &event_handler, const Task<Callable> &task)
+TaskInterface* EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::bindEventHandler(TaskInterface* &event_handler, const Task<Callable> &task)
 {
     if(event_handler)
         clearEventHandler(event_handler);   // remove old binding first
-    auto p = m_task_queue.push(task.template transform<EventTask>());
+    auto event = task.template transform<EventTask>();
+    auto p = pushResident(&event);
     if(p)
         p->setKeeper(&event_handler);
-    else if(m_helper_functions && m_helper_functions->onTaskAllocationFailed)
-        m_helper_functions->onTaskAllocationFailed(task.faddr());
+    else
+        allocationFailed(task.faddr());
     
     event_handler = p;
-    m_next_end = m_task_queue.end();
     return p;
 }
 
-template<std::size_t taskbuf_size>
-void EventLoop<taskbuf_size>::clearEventHandler(TaskInterface* &taskptr)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::clearEventHandler(TaskInterface* &taskptr)
 {
     if(taskptr && taskptr->type() == TaskType::EVENT)
-        m_task_queue.disable(taskptr);
+        disableTask(taskptr);
     taskptr = nullptr;
 }
 
+// destroy the resident event handlers cleared while firing, unless one is firing still, e.g. from another thread
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::destroyClearedEvents()
+{
+    m_cleared_events = 0;
+    for(SlotIndex i=0; i<resident_slots; i++)
+    {
+        if(!m_resident_pool.isBusy(i) || !m_resident_pool.at(i)->isCleared())
+            continue;
+        if(m_resident_pool.at(i)->isFiring())
+            m_cleared_events++;
+        else
+            m_resident_pool.destroy(i);
+    }
+}
+
 // run the current queue
-template<std::size_t taskbuf_size>
-void EventLoop<taskbuf_size>::runCurrentQueue(int16_t passed_ms)
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::runCurrentQueue(uint32_t passed_ms)
 {
+    if(m_cleared_events)
+        destroyClearedEvents();
+    runTimers(passed_ms);
+    Time now;               // read once per pass and only if a long timeout is queued, like passed_ms
+    bool now_read = false;  // a deadline passing during the pass is seen by the next one
     TaskInterface *p = m_cur_begin;
     while(p != m_delimiter)
     {
+        m_sweeping = p;
         switch (p->type()) 
         {
         case TaskType::DEFAULT_TASK:
-            p->exec();
+            execute(p);
             break;
         case TaskType::TIMEOUT:
-            if((int32_t)p->getTimeLeft() <= passed_ms)
-                p->exec();
+            if(p->getTimeLeft() <= passed_ms)
+            {
+                INSTRUMENT(m_stats.recordLag(passed_ms - p->getTimeLeft());)
+                execute(p);
+            }
             else
             {
                 p->setTimeLeft(p->getTimeLeft()-passed_ms);
-                nextTick(p);
+                requeue(p);
             }
             break;
         case TaskType::LONGTIMEOUT:
-            if(p->getScheduleTime() <= Time::absolute())
-                p->exec();
+            if(!now_read)
+            {
+                now = Time::absolute();
+                now_read = true;
+            }
+            if(p->getScheduleTime() <= now)
+            {
+                INSTRUMENT(m_stats.recordLag(now - p->getScheduleTime());)
+                execute(p);
+            }
             else
-                nextTick(p);
+                requeue(p);
             break;
-        case TaskType::EVENT:
+        case TaskType::MICROTIMEOUT:
         {
-            auto next = nextTick(p);
-            if(next)
-                next->updateKeeper();
+            const int32_t late = Time::micros() - p->getDeadlineUs();
+            if(late >= 0)
+            {
+                INSTRUMENT(m_stats.recordLag(late/1000);)
+                execute(p);
+            }
+            else
+                requeue(p);
             break;
         }
+        case TaskType::EVENT:
+            if(!p->isCleared() || p->isFiring())    // a handler cleared while firing is dropped here, pop() destroys it
+                requeue(p);
+            break;
         case TaskType::INTERVAL:
         {
-            auto t = (int32_t)p->getTimeLeft();
-            if(t <= passed_ms)
+            if(p->getTimeLeft() <= passed_ms)
             {
-                p->exec();
+                INSTRUMENT(m_stats.recordLag(passed_ms - p->getTimeLeft());)
+                execute(p);
                 p->setTimeLeft(p->getInterval());
             }
             else
                 p->setTimeLeft(p->getTimeLeft()-passed_ms);
-            nextTick(p);
+            if(p->type() == TaskType::INTERVAL) // it may clear itself
+                requeue(p);
             break;
         }
-        default:
+        default:    // dead runs are dropped, never requeued
+            INSTRUMENT(m_stats.swept_bytes += p->size();)
             break;
         }
         p = m_task_queue.next(p);
@@ -346,8 +827,124 @@ void EventLoop<taskbuf_size>::runCurrentQueue(int16_t passed_ms)
         m_task_queue.pop();
         m_cur_begin = p;
     }   
+    m_sweeping = nullptr;
     // after: m_cur_begin == m_delimiter
     m_delimiter = m_next_end;
 }
 
+// advance the timer wheel and execute the expired timers right in their slots
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::runTimers(uint32_t passed_ms)
+{
+    m_timer_wheel.advance(passed_ms);
+    INSTRUMENT(bool fired = false;)
+    SlotIndex i;
+    while((i = m_timer_wheel.popExpired()) != NoSlot)
+    {
+        TaskInterface *p = m_resident_pool.at(i);
+        if(p->type() == TaskType::LONGTIMEOUT)
+        {   // the wheel only counts passed_ms, the schedule time has the final word
+            const Time now = Time::absolute();
+            if(p->getScheduleTime() > now)
+            {
+                const uint64_t left = p->getScheduleTime() - now;
+                m_timer_wheel.insert(i, left < TimerWheel<resident_slots>::MAX_DELAY ? left : TimerWheel<resident_slots>::MAX_DELAY, m_timer_wheel.slackOf(i));
+                continue;
+            }
+        }
+        else if(p->type() == TaskType::MICROTIMEOUT)
+        {   // the wheel only had the whole ms, under one left it is due again in the next pass
+            const int32_t left = p->getDeadlineUs() - Time::micros();
+            if(left > 0)
+            {
+                m_timer_wheel.insert(i, left/1000);
+                continue;
+            }
+        }
+        INSTRUMENT(m_stats.recordLag(p->type() == TaskType::LONGTIMEOUT ?
+            (uint32_t)(Time::absolute() - p->getScheduleTime()) : p->type() == TaskType::MICROTIMEOUT ?
+            (uint32_t)(Time::micros() - p->getDeadlineUs())/1000 : m_timer_wheel.lateness(i));)
+        INSTRUMENT(fired = true;)
+        m_running = i;
+        execute(p);
+        if(!m_running_cleared && p->type() == TaskType::INTERVAL)
+            m_timer_wheel.insert(i, p->getInterval(), m_timer_wheel.slackOf(i));
+        else
+            m_resident_pool.destroy(i);
+        m_running = NoSlot;
+        m_running_cleared = false;
+    }
+    INSTRUMENT(if(fired) m_stats.timer_passes++;)
+}
+
+// find the earliest deadline among the timer wheel and the timer tasks left in the queue
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+uint32_t EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::nextDeadline()
+{
+    if(!m_injected.empty() || m_cleared_events)
+        return 0;
+    uint32_t earliest = m_timer_wheel.nextExpiry();
+    for(TaskInterface* ptr = m_cur_begin; ptr != m_next_end && earliest; ptr = m_task_queue.next(ptr))
+    {
+        uint32_t left = NoDeadline;
+        switch (ptr->type())
+        {
+        case TaskType::DEFAULT_TASK:
+            return 0;
+        case TaskType::TIMEOUT:
+        case TaskType::INTERVAL:
+            left = ptr->getTimeLeft();
+            break;
+        case TaskType::LONGTIMEOUT:
+        {
+            const Time now = Time::absolute();
+            left = ptr->getScheduleTime() > now ? ptr->getScheduleTime() - now : 0;
+            break;
+        }
+        case TaskType::MICROTIMEOUT:
+        {
+            const int32_t left_us = ptr->getDeadlineUs() - Time::micros();
+            left = left_us > 0 ? left_us/1000 : 0;
+            break;
+        }
+        default:    // event tasks only run through their keepers
+            break;
+        }
+        if(left < earliest)
+            earliest = left;
+    }
+    return earliest;
+}
+
+// hand the time until the next deadline to the idle hook, and count how long it slept
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::idle()
+{
+    const uint32_t budget = nextDeadline();
+    // the next interrupt may be a whole tick away, a deadline closer than that is waited out by running passes
+    if(budget >= Time::tickMillis() && !__atomic_load_n(&m_wakeup.flag, __ATOMIC_ACQUIRE))
+    {
+        const ShortTime before = Time::absoluteShort();
+        m_helper_functions->idle(budget, m_wakeup.flag);
+        m_idle_stats.wakeups++;
+        m_idle_stats.idle_ms += Time::absoluteShort() - before;
+    }
+    m_wakeup.clear();
+}
+
+// move the tasks posted by ISRs into the loop, the ones for the queue join the current pass
+template<std::size_t taskbuf_size, std::size_t resident_slots, std::size_t resident_slot_size, std::size_t handle_slots, std::size_t inject_slots>
+void EventLoop<taskbuf_size, resident_slots, resident_slot_size, handle_slots, inject_slots>::drainInjected()
+{
+    TaskInterface* p = m_injected.front();
+    if(!p)
+        return;
+    for(; p; p = m_injected.front())
+    {
+        accept(p);
+        m_injected.pop();
+    }
+    m_delimiter = m_next_end;   // between two passes m_cur_begin to m_delimiter is already the whole queue
+}
+
 #endif
\ No newline at end of file
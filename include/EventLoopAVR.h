@@ -12,6 +12,9 @@
 #include "Keys.h"
 #include "EventLoop.h"
 #include "PipeIO.h"
+#include "Framing.h"
 #include "Time.h"
+#include "CivilTime.h"
+#include "Idle.h"
 
 #endif
\ No newline at end of file
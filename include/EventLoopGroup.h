@@ -0,0 +1,157 @@
+#ifndef __EVENTLOOPGROUP_H__
+    #define __EVENTLOOPGROUP_H__
+
+#include "Platform.h"
+
+#ifndef PLATFORM_POSIX
+    #error "EventLoopGroup: only the POSIX host has threads to run the shards on"
+#endif
+
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+
+#include "EventLoop.h"
+#include "InjectionQueue.h"
+#include "Idle.h"
+
+/*
+    EventLoopGroup: loop_count independent loops, the shards, each run by its own thread with its own queue, pool and wheel.
+    A task is sent to a shard by key, the same key always lands on the same shard, so the tasks of one key sent from
+    one thread run in the order they are sent. Nothing else is shared: a shard only ever touches its own loop,
+    other shards reach it through the mailboxes.
+    The mailboxes are InjectionQueue rings, one per (shard, sender) pair, so every ring has a single producer and
+    posting is lock-free. Senders are the shards themselves plus ONE outside thread, e.g. the one that started the group.
+    Tasks sent are at most Loop::RESIDENT_SLOT_SIZE bytes, like post().
+*/
+template<std::size_t loop_count, typename Loop = EventLoop<>, std::size_t mail_slots = 16>
+class EventLoopGroup
+{
+static_assert(loop_count > 0, "EventLoopGroup: loop_count must be at least 1");
+public:
+    using Mailbox = InjectionQueue<mail_slots, Loop::RESIDENT_SLOT_SIZE>;
+    static constexpr std::size_t LOOP_COUNT = loop_count;
+    static constexpr std::size_t OUTSIDE = loop_count;     // the sender index of the outside thread
+private:
+    // which shard of which group the calling thread runs
+    struct Context
+    {
+        const void* group = nullptr;
+        std::size_t shard = 0;
+    };
+    static Context& context() { static thread_local Context self; return self; }
+
+    Loop m_loops[loop_count];
+    Mailbox m_mailboxes[loop_count][loop_count+1];  // [receiver][sender]
+    std::thread m_threads[loop_count];
+    uint8_t m_stop = 0;     // read and written with the atomic builtins
+
+    // move the mail into the loop, the senders in a fixed order
+    void drain(std::size_t shard)
+    {
+        for(auto& mailbox : m_mailboxes[shard])
+            for(TaskInterface* p = mailbox.front(); p; p = mailbox.front())
+            {
+                m_loops[shard].accept(p);
+                mailbox.pop();
+            }
+    }
+    bool send(uint32_t key, const TaskInterface* ptr)
+    {
+        const std::size_t to = shardOf(key);
+        const std::size_t from = currentShard();
+        if(from == to)  // to itself, no need to go through the mailbox
+            return m_loops[to].accept(ptr) != nullptr;
+        const bool ok = m_mailboxes[to][from].push(ptr);
+        m_loops[to].wakeup();
+        return ok;
+    }
+public:
+    // every loop gets the helper functions, a nullptr or one without an idle hook blocks idle shards in sleepUntilInterrupt
+    EventLoopGroup(const EventLoopHelperFunctions* helper_functions = nullptr)
+    {
+        static const EventLoopHelperFunctions sleeping{nullptr, nullptr, nullptr, sleepUntilInterrupt};
+        for(auto& loop : m_loops)
+            loop.setHelperFunctions(helper_functions && helper_functions->idle ? helper_functions : &sleeping);
+    }
+    EventLoopGroup(const EventLoopGroup&) = delete;
+    ~EventLoopGroup()
+    {
+        stop();
+        join();
+    }
+
+    static constexpr std::size_t shardOf(uint32_t key) { return key % loop_count; }
+    // the shard the calling thread runs, OUTSIDE if it runs none of this group
+    std::size_t currentShard() const
+    {
+        const Context& c = context();
+        return c.group == this ? c.shard : OUTSIDE;
+    }
+    Loop& loop(std::size_t shard) { return m_loops[shard]; }
+
+    // run the task on the shard of key in its next pass, false if the mailbox is full or the task too large
+    template<typename Callable>
+    bool post(uint32_t key, const Task<Callable>& task) { return send(key, &task); }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    bool post(uint32_t key, Callable callable, Args... args)
+    { return post(key, make_task(callable).setArgs({args...})); }
+    // the same, ms after the shard takes it, no handle is returned
+    template<typename Callable>
+    bool postTimeout(uint32_t key, const Task<Callable>& task, uint16_t ms)
+    {
+        auto timeout = task.template transform<TimeoutTask>();
+        timeout.setTimeLeft(ms);
+        return send(key, &timeout);
+    }
+    template<typename Callable, typename ...Args, typename = decltype(std::invoke(std::declval<Callable>(), std::declval<Args>()...))>
+    bool postTimeout(uint32_t key, Callable callable, uint16_t ms, Args... args)
+    { return postTimeout(key, make_task(callable).setArgs({args...}), ms); }
+    // posts to shard rejected since constructed, from every sender
+    uint32_t droppedPosts(std::size_t shard) const
+    {
+        uint32_t dropped = 0;
+        for(const auto& mailbox : m_mailboxes[shard])
+            dropped += mailbox.dropped();
+        return dropped;
+    }
+
+    // the body of the thread running shard, returns after stop(). idle shards block in the idle hook until mail arrives
+    void runShard(std::size_t shard)
+    {
+        context() = Context{this, shard};
+        Loop& loop = m_loops[shard];
+        ShortTime prev = Time::absoluteShort();
+        while(!__atomic_load_n(&m_stop, __ATOMIC_ACQUIRE))
+        {
+            drain(shard);
+            ShortTime now = Time::absoluteShort();
+            loop.runOnce(now-prev);
+            prev = now;
+            loop.idle();
+        }
+        context() = Context();
+    }
+    // one thread per shard
+    void start()
+    {
+        __atomic_store_n(&m_stop, 0, __ATOMIC_RELEASE);
+        for(std::size_t i=0; i<loop_count; i++)
+            m_threads[i] = std::thread([this, i](){ runShard(i); });
+    }
+    // ask every shard to return, the tasks and mail left do not run any more
+    void stop()
+    {
+        __atomic_store_n(&m_stop, 1, __ATOMIC_RELEASE);
+        for(auto& loop : m_loops)
+            loop.wakeup();
+    }
+    void join()
+    {
+        for(auto& thread : m_threads)
+            if(thread.joinable())
+                thread.join();
+    }
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __EVENTLOOPHOST_H__
+    #define __EVENTLOOPHOST_H__
+
+/* A host build always uses the full c++ standard library */
+#ifndef USE_STDCPP_LIB
+    #define USE_STDCPP_LIB
+#endif
+
+/*
+    The same core as EventLoopAVR.h, for running natively on a POSIX host, e.g. for perf, sanitizers and benchmarks.
+    Time runs from the monotonic clock, other threads play the ISRs: post() and wakeup() are safe from ONE of them.
+    PipeIO<stdoutSendByte> or PipeIO<fdSendByte<fd>> stand in for a uart, PipeIO<fdSendByte<fd>, 0, fdWrite<fd>>
+    for one that writes whole buffers.
+*/
+#include "Platform.h"
+#include "EventLoop.h"
+#include "PipeIO.h"
+#include "Framing.h"
+#include "Time.h"
+#include "CivilTime.h"
+#include "Idle.h"
+
+#endif
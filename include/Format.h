@@ -0,0 +1,286 @@
+#ifndef __FORMAT_H__
+    #define __FORMAT_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+/*
+    Format: the number formatting core of PipeIO, digits go to any sink(char) the caller gives.
+    Decimal digits come 4 at a time from 16bit groups, multiplied out of a binary fraction without any division,
+    so a 32bit number takes at most 2 divisions by the constants 10000 and 10^8 instead of 2 per digit, a 64bit one
+    2 more by 10^8 first. Radix 2, 8 and 16 are shifts and masks. Fixed point numbers are formatted in integers only.
+    The layout follows printf: "%08d" pads with zeros between the sign and the digits, "%8d" with spaces in front.
+*/
+struct NumberFormat
+{
+    uint8_t radix;      // 2, 8, 10 or 16
+    uint8_t width;      // the least number of chars, padded with fill
+    char fill;          // '0' pads after the sign and the prefix, anything else in front of them
+    bool prefix;        // "0x" for radix 16, "0b" for 2, "0" for 8
+
+    constexpr NumberFormat(uint8_t radix=10, uint8_t width=0, char fill=' ', bool prefix=false) :
+    radix(radix), width(width), fill(fill), prefix(prefix) {}
+
+    static constexpr NumberFormat dec(uint8_t width=0, char fill=' ') { return NumberFormat(10, width, fill); }
+    static constexpr NumberFormat hex(uint8_t width=0, char fill='0') { return NumberFormat(16, width, fill, true); }
+    static constexpr NumberFormat bin(uint8_t width=0, char fill='0') { return NumberFormat(2, width, fill, true); }
+};
+
+namespace format_impl
+{
+
+// the 4 digits of v < 10000 in out[0..3]: v/1000 as a fraction of 2^23, each digit multiplied out of it by 10
+// in turn. 8389 = ceil(2^23/1000) is exact for every v < 10000, no division and no branch
+inline void digits4(uint16_t v, char* out)
+{
+    const uint32_t mask = (1UL<<23) - 1;
+    uint32_t f = v*8389UL;
+    out[0] = '0' + (f >> 23);
+    f = (f & mask)*10;
+    out[1] = '0' + (f >> 23);
+    f = (f & mask)*10;
+    out[2] = '0' + (f >> 23);
+    f = (f & mask)*10;
+    out[3] = '0' + (f >> 23);
+}
+
+// the digits of v, all 8 of them for v < 10^8, written in front of end
+inline char* digits8(uint32_t v, char* end)
+{
+    const uint16_t high = v/10000;
+    digits4(v - high*10000UL, end-4);
+    digits4(high, end-8);
+    return end-8;
+}
+
+// the digits of v in front of end without leading zeros, at most 10
+inline char* decimal(uint32_t v, char* end)
+{
+    char* p;
+    if(v < 10000)
+        digits4(v, p = end-4);
+    else if(v < 100000000)
+        p = digits8(v, end);
+    else
+    {
+        const uint16_t high = v/100000000;
+        digits8(v - high*100000000UL, end);
+        digits4(high, p = end-12);
+    }
+    while(p < end-1 && *p == '0')
+        p++;
+    return p;
+}
+
+// at most 20 digits, 64bit math only for what does not fit 32 bits
+inline char* decimal(uint64_t v, char* end)
+{
+    if(v <= 0xFFFFFFFF)
+        return decimal((uint32_t)v, end);
+    const uint64_t high = v/100000000;
+    digits8(v - high*100000000, end);
+    if(high <= 0xFFFFFFFF)
+        return decimal((uint32_t)high, end-8);
+    const uint16_t top = high/100000000;
+    digits8(high - top*100000000ULL, end-8);
+    return decimal((uint32_t)top, end-16);
+}
+
+template<typename U>
+char* power2(U v, char* end, uint8_t shift)
+{
+    const uint8_t mask = (1<<shift) - 1;
+    do
+    {
+        *--end = "0123456789ABCDEF"[(uint8_t)v & mask];
+        v >>= shift;
+    } while(v);
+    return end;
+}
+
+template<typename U>
+char* digits(U v, char* end, uint8_t radix)
+{
+    switch(radix)
+    {
+    case 2: return power2(v, end, 1);
+    case 8: return power2(v, end, 3);
+    case 16: return power2(v, end, 4);
+    default: return decimal(v, end);
+    }
+}
+
+// 10^n for n <= 9, by multiplying
+inline uint32_t powerOf10(uint8_t n)
+{
+    uint32_t p = 1;
+    while(n--)
+        p *= 10;
+    return p;
+}
+
+template<typename Sink>
+void repeat(Sink& sink, char c, uint8_t n)
+{
+    while(n--)
+        sink(c);
+}
+
+// sign, prefix and padding around the integer digits and the optional fraction digits after a '.'
+template<typename Sink>
+void emit(Sink& sink, bool negative, const NumberFormat& format, const char* digits, uint8_t length,
+          const char* fraction=nullptr, uint8_t fraction_length=0)
+{
+    if(format.width == 0 && !format.prefix && !fraction)   // what operator<< does
+    {
+        if(negative)
+            sink('-');
+        for(uint8_t i=0; i<length; i++)
+            sink(digits[i]);
+        return;
+    }
+    const char* prefix = "";
+    if(format.prefix)
+        prefix = format.radix == 16 ? "0x" : format.radix == 2 ? "0b" : format.radix == 8 && *digits != '0' ? "0" : "";
+    uint8_t prefix_length = 0;
+    while(prefix[prefix_length])
+        prefix_length++;
+    const uint16_t total = negative + prefix_length + length + (fraction ? 1 + fraction_length : 0);
+    const uint8_t padding = format.width > total ? format.width - total : 0;
+    if(format.fill != '0')
+        repeat(sink, format.fill, padding);
+    if(negative)
+        sink('-');
+    for(const char* p = prefix; *p; p++)
+        sink(*p);
+    if(format.fill == '0')
+        repeat(sink, '0', padding);
+    for(uint8_t i=0; i<length; i++)
+        sink(digits[i]);
+    if(!fraction)
+        return;
+    sink('.');
+    for(uint8_t i=0; i<fraction_length; i++)
+        sink(fraction[i]);
+}
+
+template<typename T> struct Unsigned;
+template<> struct Unsigned<int32_t> { using type = uint32_t; };
+template<> struct Unsigned<int64_t> { using type = uint64_t; };
+template<> struct Unsigned<uint32_t> { using type = uint32_t; };
+template<> struct Unsigned<uint64_t> { using type = uint64_t; };
+
+template<typename T>
+bool isNegative(T v) { return v < 0; }
+inline bool isNegative(uint32_t) { return false; }
+inline bool isNegative(uint64_t) { return false; }
+
+// |v| without overflowing on the most negative value
+template<typename T>
+typename Unsigned<T>::type magnitude(T v)
+{
+    using U = typename Unsigned<T>::type;
+    return isNegative(v) ? U(0) - (U)v : (U)v;
+}
+
+// the fraction digits of frac/10^decimals, zero padded
+inline void fractionDigits(uint32_t frac, uint8_t decimals, char* out)
+{
+    char buffer[12];
+    const char* p = decimal(frac, buffer+sizeof(buffer));
+    const uint8_t length = buffer + sizeof(buffer) - p;
+    for(uint8_t i=0; i<decimals; i++)
+        out[i] = i + length < decimals ? '0' : p[i + length - decimals];
+}
+
+};
+
+// any of int32_t, uint32_t, int64_t, uint64_t in any radix
+template<typename Sink, typename T>
+void formatInteger(Sink& sink, T value, const NumberFormat& format=NumberFormat())
+{
+    char buffer[sizeof(T)*8];
+    char* const end = buffer + sizeof(buffer);
+    const char* p = format_impl::digits(format_impl::magnitude(value), end, format.radix);
+    format_impl::emit(sink, format_impl::isNegative(value), format, p, end-p);
+}
+
+// a decimal fixed point number: scaled is the value times 10^decimals, 12345 with 2 decimals is "123.45"
+template<typename Sink, typename T>
+void formatDecimal(Sink& sink, T scaled, uint8_t decimals, const NumberFormat& format=NumberFormat::dec())
+{
+    if(decimals > 9)
+        decimals = 9;
+    const auto m = format_impl::magnitude(scaled);
+    const uint32_t power = format_impl::powerOf10(decimals);
+    const auto integer = m/power;
+    char buffer[20], fraction[9];     // decimal() writes 12 chars for 32 bits, 20 for 64
+    char* const end = buffer + sizeof(buffer);
+    const char* p = format_impl::decimal(integer, end);
+    format_impl::fractionDigits((uint32_t)(m - integer*power), decimals, fraction);
+    format_impl::emit(sink, format_impl::isNegative(scaled), format, p, end-p, decimals ? fraction : nullptr, decimals);
+}
+
+/*
+    a binary fixed point number, the low frac_bits of q are the fraction, e.g. Q16.16 with frac_bits 16.
+    the fraction is rounded to decimals (at most 4) digits half to even like printf does,
+    frac_bits is at most 16 so it all stays in 32 bits
+*/
+template<typename Sink>
+void formatFixed(Sink& sink, int32_t q, uint8_t frac_bits, uint8_t decimals, const NumberFormat& format=NumberFormat::dec())
+{
+    if(decimals > 4)
+        decimals = 4;
+    if(frac_bits > 16)
+        frac_bits = 16;
+    const uint32_t m = format_impl::magnitude(q);
+    uint32_t integer = m >> frac_bits;
+    const uint32_t power = format_impl::powerOf10(decimals);
+    uint32_t frac = 0;
+    if(frac_bits)
+    {
+        const uint32_t scaled = (m & ((1UL<<frac_bits) - 1)) * power;
+        const uint32_t half = 1UL << (frac_bits-1), rest = scaled & ((1UL<<frac_bits) - 1);
+        frac = scaled >> frac_bits;
+        if(rest > half || (rest == half && (decimals ? frac & 1 : integer & 1)))
+            frac++;
+        if(frac == power)
+        {
+            frac = 0;
+            integer++;
+        }
+    }
+    char buffer[12], fraction[4];
+    char* const end = buffer + sizeof(buffer);
+    const char* p = format_impl::decimal(integer, end);
+    format_impl::fractionDigits(frac, decimals, fraction);
+    format_impl::emit(sink, q < 0, format, p, end-p, decimals ? fraction : nullptr, decimals);
+}
+
+// a float rounded to decimals (at most 7) digits: the integer part is cut off before the one multiplication
+template<typename Sink>
+void formatFloat(Sink& sink, float number, uint8_t decimals, const NumberFormat& format=NumberFormat::dec())
+{
+    if(decimals > 7)
+        decimals = 7;
+    const bool negative = number < 0;
+    const float m = negative ? -number : number;
+    uint32_t integer = m < 4294967040.0f ? (uint32_t)m : 0xFFFFFFFF;
+    const uint32_t power = format_impl::powerOf10(decimals);
+    uint32_t frac = integer == 0xFFFFFFFF ? 0 : (uint32_t)((m - integer)*power + 0.5f);
+    if(frac >= power)
+    {
+        frac -= power;
+        integer++;
+    }
+    char buffer[12], fraction[7];
+    char* const end = buffer + sizeof(buffer);
+    const char* p = format_impl::decimal(integer, end);
+    format_impl::fractionDigits(frac, decimals, fraction);
+    format_impl::emit(sink, negative, format, p, end-p, decimals ? fraction : nullptr, decimals);
+}
+
+#endif
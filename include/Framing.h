@@ -0,0 +1,519 @@
+#ifndef __FRAMING_H__
+    #define __FRAMING_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstring>
+#else
+    #include "no_stdcpp_lib.h"
+    #include <string.h>
+#endif
+
+#include "PipeIO.h"
+
+/*
+    Framing: binary frames over the byte stream of a PipeIO, checked by a CRC so line noise never reaches the handler.
+    A frame is the payload and its CRC (little endian), encoded by a codec so that one byte, the delimiter, never
+    shows up inside, then the delimiter. Cobs (consistent overhead byte stuffing) adds 1 byte per 254 and delimits
+    with 0, Slip (RFC 1055) escapes 0xC0 and 0xDB into 2 bytes each, up to double the size, but never holds a byte back.
+    Sending: sendFrame() / writeFrame() encode straight from the payload, no second buffer. FrameWriter builds a frame
+    piece by piece, Cobs holding back one block of at most 254 bytes, Slip nothing.
+    Receiving: FrameDecoder collects the encoded bytes of a frame in its buffer, decodes them in place once the
+    delimiter comes, checks the CRC and hands onFrame the payload where it was decoded. Broken frames are counted.
+*/
+
+// how a Crc goes through the bytes, each one faster and bigger than the one before
+enum class CrcKernel : uint8_t
+{
+    BITWISE,    // 8 shifts a byte, no table
+    NIBBLE,     // 2 lookups a byte into 16 entries, computed at compile time
+    TABLE,      // 1 lookup a byte into 256 entries, built on first use
+    SLICE4,     // 4 bytes a step through 4 tables of 256
+    SLICE8,     // 8 bytes a step through 8 tables of 256, 8KB for a Crc32
+};
+
+// an 8bit core shifts a byte at a time anyway, slicing only eats its ram
+#ifndef FRAMING_CRC_KERNEL
+    #if defined(__AVR__)
+        #define FRAMING_CRC_KERNEL CrcKernel::NIBBLE
+    #else
+        #define FRAMING_CRC_KERNEL CrcKernel::SLICE8
+    #endif
+#endif
+
+namespace crc_impl
+{
+
+// the register after shifting bits bits of v out, reflected: the low bit goes first
+template<typename T>
+constexpr T shift(T v, T poly, uint8_t bits)
+{
+    return bits == 0 ? v : shift<T>((v & 1) ? (T)((v >> 1) ^ poly) : (T)(v >> 1), poly, bits-1);
+}
+
+template<typename T, T poly>
+struct NibbleTable
+{
+    static constexpr T entry[16] = {
+        shift<T>(0, poly, 4), shift<T>(1, poly, 4), shift<T>(2, poly, 4), shift<T>(3, poly, 4),
+        shift<T>(4, poly, 4), shift<T>(5, poly, 4), shift<T>(6, poly, 4), shift<T>(7, poly, 4),
+        shift<T>(8, poly, 4), shift<T>(9, poly, 4), shift<T>(10, poly, 4), shift<T>(11, poly, 4),
+        shift<T>(12, poly, 4), shift<T>(13, poly, 4), shift<T>(14, poly, 4), shift<T>(15, poly, 4),
+    };
+};
+template<typename T, T poly>
+constexpr T NibbleTable<T, poly>::entry[16];
+
+// table[s][b] is the register after b and then s zero bytes
+template<typename T, T poly, uint8_t slices>
+struct SliceTables
+{
+    T table[slices][256];
+
+    SliceTables()
+    {
+        for(uint16_t i=0; i<256; i++)
+            table[0][i] = shift<T>(i, poly, 8);
+        for(uint8_t s=1; s<slices; s++)
+            for(uint16_t i=0; i<256; i++)
+                table[s][i] = (table[s-1][i] >> 8) ^ table[0][table[s-1][i] & 0xFF];
+    }
+    static const SliceTables& get() { static const SliceTables self; return self; }
+};
+
+inline uint32_t load32(const uint8_t* p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+template<typename T, T poly, CrcKernel kernel>
+struct Kernel;
+
+template<typename T, T poly>
+struct Kernel<T, poly, CrcKernel::BITWISE>
+{
+    static T update(T crc, const uint8_t* p, std::size_t n)
+    {
+        while(n--)
+        {
+            crc ^= *p++;
+            for(uint8_t i=0; i<8; i++)
+                crc = (crc & 1) ? (T)((crc >> 1) ^ poly) : (T)(crc >> 1);
+        }
+        return crc;
+    }
+};
+
+template<typename T, T poly>
+struct Kernel<T, poly, CrcKernel::NIBBLE>
+{
+    static T update(T crc, const uint8_t* p, std::size_t n)
+    {
+        using Table = NibbleTable<T, poly>;
+        while(n--)
+        {
+            crc ^= *p++;
+            crc = (crc >> 4) ^ Table::entry[crc & 0x0F];
+            crc = (crc >> 4) ^ Table::entry[crc & 0x0F];
+        }
+        return crc;
+    }
+};
+
+template<typename T, T poly>
+struct Kernel<T, poly, CrcKernel::TABLE>
+{
+    static T update(T crc, const uint8_t* p, std::size_t n)
+    {
+        const auto& t = SliceTables<T, poly, 1>::get().table;
+        while(n--)
+            crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        return crc;
+    }
+};
+
+// the register is xored into the first 4 bytes, then every byte goes through the table of how far it is from the end
+template<typename T, T poly>
+struct Kernel<T, poly, CrcKernel::SLICE4>
+{
+    static T update(T crc, const uint8_t* p, std::size_t n)
+    {
+        const auto& t = SliceTables<T, poly, 4>::get().table;
+        for(; n >= 4; n -= 4, p += 4)
+        {
+            const uint32_t x = crc ^ load32(p);
+            crc = t[3][x & 0xFF] ^ t[2][(x >> 8) & 0xFF] ^ t[1][(x >> 16) & 0xFF] ^ t[0][x >> 24];
+        }
+        while(n--)
+            crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        return crc;
+    }
+};
+
+template<typename T, T poly>
+struct Kernel<T, poly, CrcKernel::SLICE8>
+{
+    static T update(T crc, const uint8_t* p, std::size_t n)
+    {
+        const auto& t = SliceTables<T, poly, 8>::get().table;
+        for(; n >= 8; n -= 8, p += 8)
+        {
+            const uint32_t x = crc ^ load32(p), y = load32(p+4);
+            crc = t[7][x & 0xFF] ^ t[6][(x >> 8) & 0xFF] ^ t[5][(x >> 16) & 0xFF] ^ t[4][x >> 24]
+                ^ t[3][y & 0xFF] ^ t[2][(y >> 8) & 0xFF] ^ t[1][(y >> 16) & 0xFF] ^ t[0][y >> 24];
+        }
+        while(n--)
+            crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+        return crc;
+    }
+};
+
+};
+
+// a reflected CRC of up to 32 bits, fed in pieces
+template<typename T, T poly, T init, T xorout, CrcKernel kernel>
+class Crc
+{
+private:
+    T m_value = init;
+public:
+    using value_type = T;
+
+    void reset() { m_value = init; }
+    void update(uint8_t c) { m_value = crc_impl::Kernel<T, poly, kernel>::update(m_value, &c, 1); }
+    void update(const void* data, std::size_t length)
+    {
+        m_value = crc_impl::Kernel<T, poly, kernel>::update(m_value, (const uint8_t*)data, length);
+    }
+    T value() const { return m_value ^ xorout; }
+
+    static T of(const void* data, std::size_t length)
+    {
+        Crc crc;
+        crc.update(data, length);
+        return crc.value();
+    }
+};
+
+// CRC-16/X-25, the FCS of HDLC and PPP, "123456789" gives 0x906E
+template<CrcKernel kernel = FRAMING_CRC_KERNEL>
+using Crc16 = Crc<uint16_t, 0x8408, 0xFFFF, 0xFFFF, kernel>;
+// CRC-32 of ethernet and zlib, "123456789" gives 0xCBF43926
+template<CrcKernel kernel = FRAMING_CRC_KERNEL>
+using Crc32 = Crc<uint32_t, 0xEDB88320, 0xFFFFFFFF, 0xFFFFFFFF, kernel>;
+
+/*
+    The codecs: encode() from memory, Stream for a frame written piece by piece, decode() in place.
+    A sink is anything called with a char, like the ones of Format.h.
+*/
+struct Cobs
+{
+    enum : uint8_t { delimiter = 0 };
+
+    // the most length bytes encode to, without the delimiter
+    static constexpr std::size_t encodedLength(std::size_t length) { return length + length/254 + 1; }
+
+    // the bytes of a then b as one: each block is counted ahead in memory and written after its code
+    template<class Sink>
+    static void encode(Sink& sink, const uint8_t* a, std::size_t a_length, const uint8_t* b=nullptr, std::size_t b_length=0)
+    {
+        const std::size_t length = a_length + b_length;
+        auto at = [=](std::size_t i) { return i < a_length ? a[i] : b[i - a_length]; };
+        std::size_t i = 0;
+        while(true)
+        {
+            uint8_t run = 0;
+            while(run < 254 && i + run < length && at(i + run))
+                run++;
+            sink((char)(run + 1));
+            for(uint8_t k=0; k<run; k++)
+                sink((char)at(i + k));
+            i += run;
+            if(i == length)     // the 0 the last code stands for is not part of the data
+                return;
+            if(run < 254)       // a full block stands for no 0
+                i++;
+        }
+    }
+
+    // holds back the bytes of the block until its length is known
+    template<class Sink>
+    class Stream
+    {
+    private:
+        Sink& m_sink;
+        uint8_t m_block[254];
+        uint8_t m_run = 0;
+        bool m_full = false;    // the last block was full and nothing came after it
+
+        void flush(uint8_t code)
+        {
+            m_sink((char)code);
+            for(uint8_t i=0; i<m_run; i++)
+                m_sink((char)m_block[i]);
+            m_run = 0;
+            m_full = code == 0xFF;
+        }
+    public:
+        explicit Stream(Sink& sink) : m_sink(sink) {}
+
+        void put(uint8_t c)
+        {
+            if(c == 0)
+                return flush(m_run + 1);
+            m_block[m_run++] = c;
+            if(m_run == 254)
+                flush(0xFF);
+        }
+        void end()
+        {
+            if(m_run || !m_full)
+                flush(m_run + 1);
+            m_full = false;
+        }
+    };
+
+    // returns false when a code points past the end. frames come cut at the 0s, so there is none inside
+    static bool decode(uint8_t* frame, uint16_t& length)
+    {
+        uint8_t* out = frame;
+        const uint8_t* p = frame;
+        const uint8_t* const end = frame + length;
+        while(p < end)
+        {
+            const uint8_t code = *p++;
+            if(code == 0 || code - 1 > end - p)
+                return false;
+            for(uint8_t i=1; i<code; i++)  // out stays behind p, short blocks are too short for memmove
+                *out++ = *p++;
+            if(code != 0xFF && p < end)
+                *out++ = 0;
+        }
+        length = out - frame;
+        return true;
+    }
+};
+
+struct Slip
+{
+    enum : uint8_t { delimiter = 0xC0, escape = 0xDB, escaped_delimiter = 0xDC, escaped_escape = 0xDD };
+
+    static constexpr std::size_t encodedLength(std::size_t length) { return 2*length; }
+
+    template<class Sink>
+    static void put(Sink& sink, uint8_t c)
+    {
+        if(c == delimiter || c == escape)
+        {
+            sink((char)escape);
+            sink((char)(c == delimiter ? escaped_delimiter : escaped_escape));
+        }
+        else
+            sink((char)c);
+    }
+
+    template<class Sink>
+    static void encode(Sink& sink, const uint8_t* a, std::size_t a_length, const uint8_t* b=nullptr, std::size_t b_length=0)
+    {
+        for(std::size_t i=0; i<a_length; i++)
+            put(sink, a[i]);
+        for(std::size_t i=0; i<b_length; i++)
+            put(sink, b[i]);
+    }
+
+    template<class Sink>
+    class Stream
+    {
+    private:
+        Sink& m_sink;
+    public:
+        explicit Stream(Sink& sink) : m_sink(sink) {}
+        void put(uint8_t c) { Slip::put(m_sink, c); }
+        void end() {}
+    };
+
+    // returns false on an escape of anything else or at the end
+    static bool decode(uint8_t* frame, uint16_t& length)
+    {
+        uint8_t* out = frame;
+        for(uint16_t i=0; i<length; i++)
+        {
+            uint8_t c = frame[i];
+            if(c == escape)
+            {
+                if(++i == length || (frame[i] != escaped_delimiter && frame[i] != escaped_escape))
+                    return false;
+                c = frame[i] == escaped_delimiter ? delimiter : escape;
+            }
+            *out++ = c;
+        }
+        length = out - frame;
+        return true;
+    }
+};
+
+namespace framing_impl
+{
+
+template<typename T>
+void storeLittleEndian(T v, uint8_t* out)
+{
+    for(uint8_t i=0; i<sizeof(T); i++, v >>= 8)
+        out[i] = (uint8_t)v;
+}
+
+template<typename T>
+T loadLittleEndian(const uint8_t* p)
+{
+    T v = 0;
+    for(uint8_t i=sizeof(T); i--; )
+        v = (T)(v << 8) | p[i];
+    return v;
+}
+
+};
+
+// the payload and its CRC encoded into sink and delimited, e.g. writeFrame<Cobs, Crc16<>>(sink, &packet, sizeof(packet))
+template<class Codec, class Crc, class Sink>
+void writeFrame(Sink& sink, const void* payload, std::size_t length)
+{
+    uint8_t trailer[sizeof(typename Crc::value_type)];
+    framing_impl::storeLittleEndian(Crc::of(payload, length), trailer);
+    Codec::encode(sink, (const uint8_t*)payload, length, trailer, sizeof(trailer));
+    sink((char)Codec::delimiter);
+}
+
+/*
+    the same through a PipeIO. with a TX ring a frame that does not fit is cut short and dropped by the receiver,
+    check txFree() against Codec::encodedLength(length + sizeof(CRC)) + 1 first
+*/
+template<class Codec, class Crc, BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void sendFrame(PipeIO<Func, tx_size, Bulk>& pipe, const void* payload, std::size_t length)
+{
+    auto sink = [&pipe](char c) { pipe.sendByte(c); };
+    writeFrame<Codec, Crc>(sink, payload, length);
+}
+
+// a frame written in pieces, e.g. the fields of a struct one by one, end() appends the CRC and delimits it
+template<class Codec, class Crc, class Sink>
+class FrameWriter
+{
+private:
+    Sink& m_sink;
+    typename Codec::template Stream<Sink> m_stream;
+    Crc m_crc;
+public:
+    explicit FrameWriter(Sink& sink) : m_sink(sink), m_stream(sink) {}
+
+    void write(uint8_t c)
+    {
+        m_crc.update(c);
+        m_stream.put(c);
+    }
+    void write(const void* data, std::size_t length)
+    {
+        m_crc.update(data, length);
+        for(std::size_t i=0; i<length; i++)
+            m_stream.put(((const uint8_t*)data)[i]);
+    }
+    void end()
+    {
+        uint8_t trailer[sizeof(typename Crc::value_type)];
+        framing_impl::storeLittleEndian(m_crc.value(), trailer);
+        for(uint8_t i=0; i<sizeof(trailer); i++)
+            m_stream.put(trailer[i]);
+        m_stream.end();
+        m_sink((char)Codec::delimiter);
+        m_crc.reset();
+    }
+};
+
+/*
+    FrameDecoder<Codec, Crc, max_frame> takes at most max_frame encoded bytes a frame, e.g.
+    Cobs::encodedLength(sizeof(Packet) + 2) for a Crc16. With PipeIO::frameNone() onData hands its RxSpan to
+    receive(), which copies it into the buffer up to each delimiter. onFrame gets the payload decoded in place there,
+    valid until it returns. Frames that overrun the buffer, do not decode or fail the CRC are dropped and counted.
+*/
+template<class Codec, class Crc, std::size_t max_frame>
+class FrameDecoder
+{
+    static_assert(max_frame <= 0xFFFF, "frames are counted in 16 bits");
+private:
+    using CrcType = typename Crc::value_type;
+
+    uint8_t m_buffer[max_frame];
+    uint16_t m_length = 0;
+    bool m_overrun = false;
+    uint16_t m_frames = 0;
+    uint16_t m_errors = 0;
+
+    void endFrame()
+    {
+        uint16_t length = m_length;
+        const bool overrun = m_overrun;
+        m_length = 0;
+        m_overrun = false;
+        if(length == 0 && !overrun)     // delimiters in a row, or the one in front of the first frame
+            return;
+        if(overrun || !Codec::decode(m_buffer, length) || length < sizeof(CrcType)
+           || Crc::of(m_buffer, length - sizeof(CrcType)) != framing_impl::loadLittleEndian<CrcType>(m_buffer + length - sizeof(CrcType)))
+        {
+            m_errors++;
+            return;
+        }
+        m_frames++;
+        if(onFrame)
+            onFrame(this, m_buffer, length - sizeof(CrcType));
+    }
+public:
+    void (*onFrame)(FrameDecoder*, const uint8_t* payload, uint16_t length) = nullptr;
+
+    void receive(uint8_t c)
+    {
+        if(c == Codec::delimiter)
+            endFrame();
+        else if(m_length < max_frame)
+            m_buffer[m_length++] = c;
+        else
+            m_overrun = true;
+    }
+    void receive(const void* data, std::size_t length)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        const uint8_t* const end = p + length;
+        while(p < end)
+        {
+            const uint8_t* delimiter = (const uint8_t*)memchr(p, Codec::delimiter, end - p);
+            const uint8_t* stop = delimiter ? delimiter : end;
+            std::size_t n = stop - p;
+            if(n > max_frame - m_length)
+            {
+                n = max_frame - m_length;
+                m_overrun = true;
+            }
+            memcpy(m_buffer + m_length, p, n);
+            m_length += n;
+            if(!delimiter)
+                return;
+            endFrame();
+            p = delimiter + 1;
+        }
+    }
+    void receive(const RxSpan& span)
+    {
+        receive(span.first, span.first_length);
+        receive(span.second, span.second_length);
+    }
+    // drop what has come of the current frame, e.g. after a timeout
+    void reset()
+    {
+        m_length = 0;
+        m_overrun = false;
+    }
+
+    // frames handed to onFrame and frames dropped, both wrap at 65536
+    uint16_t frames() const { return m_frames; }
+    uint16_t errors() const { return m_errors; }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __IDLE_H__
+    #define __IDLE_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Platform.h"
+
+/*
+    Idle hooks for EventLoopHelperFunctions::idle
+*/
+
+#ifdef PLATFORM_AVR
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+// sleep in SLEEP_MODE_IDLE until any interrupt fires, the timer ISR driving Time::tick() wakes the loop in time.
+// wakeup is checked with interrupts disabled, and sei takes effect after sleep_cpu, so a wakeup() from an ISR is never missed
+inline void sleepUntilInterrupt(uint32_t budget_ms, const volatile uint8_t& wakeup)
+{
+    (void)budget_ms;
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    if(!wakeup)
+    {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+#else   // PLATFORM_POSIX
+
+// block on the condvar of the loop until the budget runs out or another thread calls its wakeup(), which notifies it
+inline void sleepUntilInterrupt(uint32_t budget_ms, const volatile uint8_t& wakeup)
+{
+    auto& signal = PlatformWakeup::of(wakeup);
+    std::unique_lock<std::mutex> guard(signal.mutex);
+    auto woken = [&wakeup](){ return __atomic_load_n(&wakeup, __ATOMIC_ACQUIRE) != 0; };
+    if(budget_ms == 0xFFFFFFFF)     // NoDeadline, only a wakeup() can end it
+        signal.cond.wait(guard, woken);
+    else
+        signal.cond.wait_for(guard, std::chrono::milliseconds(budget_ms), woken);
+}
+
+#endif
+
+#endif
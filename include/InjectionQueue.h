@@ -0,0 +1,81 @@
+#ifndef __INJECTIONQUEUE_H__
+    #define __INJECTIONQUEUE_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Task.h"
+
+/*
+    InjectionQueue: a single-producer single-consumer ring of fixed size slots, for tasks posted from ISRs.
+    push() is wait-free and never touches what the consumer owns, so an ISR can interrupt the loop anywhere.
+    Only ONE producer context is allowed, e.g. ISRs that do not nest, or one thread on a host.
+    The indexes are single bytes published with acquire/release builtins, plain loads/stores on avr.
+*/
+template<std::size_t slot_count, std::size_t slot_size>
+class InjectionQueue
+{
+static_assert(slot_count > 0 && slot_count < 0xFF, "InjectionQueue: slot_count must be in range [1, 254]");
+static_assert(slot_size >= sizeof(TaskInterface), "InjectionQueue: slot_size is too small to hold any task");
+private:
+    static constexpr uint8_t storage_count = slot_count+1;  // one slot is always empty to tell full from empty
+    union alignas(TaskAlignment) Slot
+    {
+        char bytes[slot_size];
+    };
+    Slot m_slots[storage_count];
+    uint8_t m_head = 0;     // written by the consumer only
+    uint8_t m_tail = 0;     // written by the producer only
+    uint8_t m_dropped = 0;  // written by the producer only
+
+    static uint8_t following(uint8_t i) { return i+1 < storage_count ? i+1 : 0; }
+public:
+    InjectionQueue() {}
+    InjectionQueue(const InjectionQueue&) = delete;
+    ~InjectionQueue()
+    {
+        while(front())
+            pop();
+    }
+
+    // tasks rejected by push() since constructed, wraps at 256
+    uint8_t dropped() const { return m_dropped; }
+    bool empty() const { return __atomic_load_n(&m_head, __ATOMIC_RELAXED) == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE); }
+
+    // producer: copy the task in, false if the queue is full or the task is larger than a slot
+    bool push(const TaskInterface* ptr)
+    {
+        const uint8_t tail = m_tail;
+        const uint8_t next = following(tail);
+        if(next == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE) || ptr->size() > slot_size)
+        {
+            m_dropped++;
+            return false;
+        }
+        ptr->copy(m_slots[tail].bytes);
+        __atomic_store_n(&m_tail, next, __ATOMIC_RELEASE);   // publish the slot after it is fully constructed
+        return true;
+    }
+
+    // consumer: the oldest task posted, nullptr if there is none
+    TaskInterface* front()
+    {
+        const uint8_t head = m_head;
+        if(head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
+            return nullptr;
+        return reinterpret_cast<TaskInterface*>(m_slots[head].bytes);
+    }
+    // consumer: destroy the front task and hand its slot back to the producer
+    void pop()
+    {
+        const uint8_t head = m_head;
+        reinterpret_cast<TaskInterface*>(m_slots[head].bytes)->destroy();
+        __atomic_store_n(&m_head, following(head), __ATOMIC_RELEASE);
+    }
+};
+
+#endif
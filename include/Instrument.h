@@ -0,0 +1,117 @@
+#ifndef __INSTRUMENT_H__
+    #define __INSTRUMENT_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Task.h"
+#include "Time.h"
+#include "PipeIO.h"
+
+/*
+    Instrumentation of EventLoop and CircularTaskQueue, define EVENTLOOP_INSTRUMENT to enable it.
+    Without it every INSTRUMENT(...) vanishes, so the loop has no extra member, no extra call and no extra byte.
+    EVENTLOOP_INSTRUMENT_TASKS functions get their own execution time record, the ones after are only counted.
+*/
+#ifdef EVENTLOOP_INSTRUMENT
+    #define INSTRUMENT(...) __VA_ARGS__
+#else
+    #define INSTRUMENT(...)
+#endif
+
+#ifndef EVENTLOOP_INSTRUMENT_TASKS
+    #define EVENTLOOP_INSTRUMENT_TASKS 8
+#endif
+
+// the clock task execution is measured with, in us
+inline uint32_t instrumentClockUs()
+{
+#ifdef PLATFORM_AVR
+    return Time::absoluteShort().ms()*1000;     // only the ms of Time on avr, short tasks read as 0
+#else
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct TaskTimingStats
+{
+    void* faddr = nullptr;
+    uint32_t count = 0;
+    uint32_t min_us = 0xFFFFFFFF;
+    uint32_t max_us = 0;
+    uint32_t sum_us = 0;
+};
+
+// the snapshot returned by EventLoop::stats()
+struct EventLoopStats
+{
+    uint16_t queue_bytes_high = 0;      // most bytes the task queue has held
+    uint16_t queue_bytes_capacity = 0;
+    uint8_t resident_high = 0;          // most resident slots taken at once
+    uint8_t resident_capacity = 0;
+    uint16_t alloc_failures = 0;        // same events as onTaskAllocationFailed
+    uint32_t reclaimed_bytes = 0;       // dead bytes handed back to the queue at its tail, before the sweep got to them
+    uint32_t swept_bytes = 0;           // dead bytes dropped by the sweep
+    uint32_t executed[(uint8_t)TaskType::DISABLED] = {0};   // tasks executed by TaskType
+    uint32_t untracked = 0;             // executions of functions beyond the timing table
+    uint32_t lag_count = 0;             // timers fired, and how late they were than their deadline in ms
+    uint32_t lag_sum_ms = 0;
+    uint32_t lag_max_ms = 0;
+    uint32_t timer_passes = 0;          // passes in which resident timers fired, one batch each
+    TaskTimingStats tasks[EVENTLOOP_INSTRUMENT_TASKS];
+
+    void recordExec(void* faddr, TaskType type, uint32_t us)
+    {
+        if((uint8_t)type < (uint8_t)TaskType::DISABLED)
+            executed[(uint8_t)type]++;
+        for(auto& t : tasks)
+        {
+            if(t.faddr != faddr && t.faddr != nullptr)
+                continue;
+            t.faddr = faddr;
+            t.count++;
+            t.sum_us += us;
+            if(us < t.min_us)
+                t.min_us = us;
+            if(us > t.max_us)
+                t.max_us = us;
+            return;
+        }
+        untracked++;
+    }
+    void recordLag(uint32_t ms)
+    {
+        lag_count++;
+        lag_sum_ms += ms;
+        if(ms > lag_max_ms)
+            lag_max_ms = ms;
+    }
+};
+
+// one "key value" per line, the timing table as "task <faddr> <count> <min> <max> <sum>"
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void dumpStats(PipeIO<Func, tx_size, Bulk>& io, const EventLoopStats& stats)
+{
+    static const char* const type_names[] = { "default", "timeout", "longtimeout", "event", "interval", "microtimeout" };
+    io << "queue_bytes " << (int32_t)stats.queue_bytes_high << '/' << (int32_t)stats.queue_bytes_capacity << '\n';
+    io << "resident " << (int32_t)stats.resident_high << '/' << (int32_t)stats.resident_capacity << '\n';
+    io << "alloc_failures " << (int32_t)stats.alloc_failures << '\n';
+    io << "reclaimed_bytes " << (int64_t)stats.reclaimed_bytes << '\n';
+    io << "swept_bytes " << (int64_t)stats.swept_bytes << '\n';
+    for(uint8_t t=0; t<(uint8_t)TaskType::DISABLED; t++)
+        io << "executed." << type_names[t] << ' ' << (int64_t)stats.executed[t] << '\n';
+    io << "untracked " << (int64_t)stats.untracked << '\n';
+    io << "lag " << (int64_t)stats.lag_count << ' ' << (int64_t)stats.lag_sum_ms << ' ' << (int64_t)stats.lag_max_ms << '\n';
+    io << "timer_passes " << (int64_t)stats.timer_passes << '\n';
+    for(const auto& t : stats.tasks)
+        if(t.faddr)
+            io << "task " << (int64_t)(uintptr_t)t.faddr << ' ' << (int64_t)t.count << ' ' << (int64_t)t.min_us << ' '
+               << (int64_t)t.max_us << ' ' << (int64_t)t.sum_us << '\n';
+}
+
+#endif
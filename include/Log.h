@@ -0,0 +1,296 @@
+#ifndef __LOG_H__
+    #define __LOG_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstring>
+#else
+    #include "no_stdcpp_lib.h"
+    #include <string.h>
+#endif
+
+#include "PipeIO.h"
+#include "Framing.h"
+
+/*
+    Log: printf-like logging that formats nothing on the device.
+    LOG_INFO("temp=%f adc=%u", t, adc) sends a record of a 16bit id and the raw arguments, COBS framed:
+    the format string only feeds a compile time hash for the id and a static_assert that the arguments match it,
+    with optimization it never reaches flash. tools/logdecode.py scans the sources for the same strings into a table
+    ("cmake --build . --target log_table") and turns the captured records back into text.
+    Integers go as zigzag varints, 1 byte below 64, floats and doubles as 4 byte floats, strings as a length byte
+    and at most 255 chars. %lld and %llu for 64bit integers, %s %c %d %i %u %x %X %o %e %f %g otherwise.
+    Levels below EVENTLOOP_LOG_LEVEL compile to nothing, the arguments are checked but never evaluated.
+    Log::to(uart) picks the PipeIO the records go to: a record is written whole, or with a TX ring that has no room
+    for it, dropped and counted. Like PipeIO, only log from one context, e.g. the loop and not the ISRs.
+*/
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_NONE  4
+
+#ifndef EVENTLOOP_LOG_LEVEL
+    #define EVENTLOOP_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+// the most bytes of one record before framing, longer ones are dropped
+#ifndef EVENTLOOP_LOG_RECORD
+    #define EVENTLOOP_LOG_RECORD 32
+#endif
+
+namespace log_impl
+{
+
+enum class Kind : uint8_t { NONE, INT, INT64, FLOAT, STRING };
+
+template<typename T> struct KindOf { static constexpr Kind value = Kind::NONE; };
+template<typename T> struct IntegerKind { static constexpr Kind value = sizeof(T) > 4 ? Kind::INT64 : Kind::INT; };
+template<> struct KindOf<bool> : IntegerKind<bool> {};
+template<> struct KindOf<char> : IntegerKind<char> {};
+template<> struct KindOf<signed char> : IntegerKind<signed char> {};
+template<> struct KindOf<unsigned char> : IntegerKind<unsigned char> {};
+template<> struct KindOf<short> : IntegerKind<short> {};
+template<> struct KindOf<unsigned short> : IntegerKind<unsigned short> {};
+template<> struct KindOf<int> : IntegerKind<int> {};
+template<> struct KindOf<unsigned int> : IntegerKind<unsigned int> {};
+template<> struct KindOf<long> : IntegerKind<long> {};
+template<> struct KindOf<unsigned long> : IntegerKind<unsigned long> {};
+template<> struct KindOf<long long> : IntegerKind<long long> {};
+template<> struct KindOf<unsigned long long> : IntegerKind<unsigned long long> {};
+template<> struct KindOf<float> { static constexpr Kind value = Kind::FLOAT; };
+template<> struct KindOf<double> { static constexpr Kind value = Kind::FLOAT; };
+template<> struct KindOf<const char*> { static constexpr Kind value = Kind::STRING; };
+template<> struct KindOf<char*> { static constexpr Kind value = Kind::STRING; };
+template<std::size_t n> struct KindOf<char[n]> { static constexpr Kind value = Kind::STRING; };
+
+template<Kind... kinds> struct Kinds {};
+
+// only ever named in decltype(): the kinds of the arguments after the format
+template<std::size_t n, typename... Args>
+Kinds<KindOf<Args>::value...> kinds(const char (&format)[n], const Args&... args);
+
+// checking a printf format against the kinds, all recursion for c++11 constexpr
+constexpr bool contains(const char* set, char c) { return *set && (*set == c || contains(set+1, c)); }
+constexpr const char* skip(const char* p, const char* set) { return *p && contains(set, *p) ? skip(p+1, set) : p; }
+constexpr const char* flags(const char* p) { return skip(p, "-+ #0123456789."); }
+constexpr bool longLong(const char* p) { return (p[0] == 'l' && p[1] == 'l') || p[0] == 'j'; }
+constexpr bool conversion(char c, Kind kind, bool is_long_long)
+{
+    return contains("diuxXoc", c) ? (kind == Kind::INT && !is_long_long) || (kind == Kind::INT64 && is_long_long)
+         : contains("fFeEgG", c) ? kind == Kind::FLOAT
+         : c == 's' ? kind == Kind::STRING
+         : false;
+}
+constexpr bool spec(const char* p, Kind kind) { return conversion(*skip(p, "hlLjzt"), kind, longLong(p)); }
+constexpr const char* afterSpec(const char* p) { return *skip(flags(p), "hlLjzt") ? skip(flags(p), "hlLjzt") + 1 : skip(flags(p), "hlLjzt"); }
+
+constexpr bool matches(const char* f, Kinds<>)
+{
+    return !*f ? true : *f != '%' ? matches(f+1, Kinds<>()) : f[1] == '%' ? matches(f+2, Kinds<>()) : false;
+}
+template<Kind kind, Kind... rest>
+constexpr bool matches(const char* f, Kinds<kind, rest...>)
+{
+    return !*f ? false
+         : *f != '%' ? matches(f+1, Kinds<kind, rest...>())
+         : f[1] == '%' ? matches(f+2, Kinds<kind, rest...>())
+         : spec(flags(f+1), kind) && matches(afterSpec(f+1), Kinds<rest...>());
+}
+
+// FNV-1a over the level digit and the format, folded to 16 bits. tools/logdecode.py does the same
+constexpr uint32_t fnv(const char* s, uint32_t h) { return *s ? fnv(s+1, (h ^ (uint8_t)*s) * 16777619UL) : h; }
+constexpr uint16_t id(uint8_t level, const char* format)
+{
+    return (uint16_t)(fnv(format, (2166136261UL ^ (uint8_t)('0' + level)) * 16777619UL) >> 16)
+         ^ (uint16_t)fnv(format, (2166136261UL ^ (uint8_t)('0' + level)) * 16777619UL);
+}
+
+struct Record
+{
+    // the lengths here and of the COBS encoded record with its delimiter are uint8_t
+    static_assert(EVENTLOOP_LOG_RECORD > 0 && EVENTLOOP_LOG_RECORD <= 253, "Log: EVENTLOOP_LOG_RECORD must be in range [1, 253]");
+    uint8_t bytes[EVENTLOOP_LOG_RECORD];
+    uint8_t length = 0;
+    bool overflow = false;
+
+    void put(uint8_t c)
+    {
+        if(length < sizeof(bytes))
+            bytes[length++] = c;
+        else
+            overflow = true;
+    }
+    void put(const char* s, uint8_t n)
+    {
+        if(n > sizeof(bytes) - length)
+        {
+            overflow = true;
+            return;
+        }
+        for(uint8_t i=0; i<n; i++)
+            bytes[length++] = s[i];
+    }
+    template<typename U>
+    void varint(U v)
+    {
+        while(v >= 0x80)
+        {
+            put((uint8_t)v | 0x80);
+            v >>= 7;
+        }
+        put((uint8_t)v);
+    }
+};
+
+template<typename T>
+void put(Record& r, T v, task_impl::Tag<false>)     // zigzag: 0 -1 1 -2 go as 0 1 2 3
+{
+    const int32_t s = (int32_t)v;
+    r.varint(s < 0 ? ~((uint32_t)s << 1) : (uint32_t)s << 1);
+}
+template<typename T>
+void put(Record& r, T v, task_impl::Tag<true>)
+{
+    const int64_t s = (int64_t)v;
+    r.varint(s < 0 ? ~((uint64_t)s << 1) : (uint64_t)s << 1);
+}
+template<typename T>
+void put(Record& r, const T& v) { put(r, v, task_impl::Tag<(sizeof(T) > 4)>()); }
+inline void put(Record& r, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    for(uint8_t i=0; i<4; i++, bits >>= 8)
+        r.put((uint8_t)bits);
+}
+inline void put(Record& r, double v) { put(r, (float)v); }
+inline void put(Record& r, const char* s)
+{
+    const size_t length = strlen(s);
+    const uint8_t n = length < 255 ? length : 255;
+    r.put(n);
+    r.put(s, n);
+}
+inline void put(Record& r, char* s) { put(r, (const char*)s); }
+template<std::size_t n>
+void put(Record& r, const char (&s)[n]) { put(r, (const char*)s); }
+
+inline void putAll(Record&) {}
+template<typename T, typename... Args>
+void putAll(Record& r, const T& first, const Args&... rest)
+{
+    put(r, first);
+    putAll(r, rest...);
+}
+
+};
+
+class Log
+{
+private:
+    struct Output
+    {
+        void* pipe;
+        bool (*write)(void* pipe, const log_impl::Record& record);
+        uint16_t dropped;
+    };
+    static Output& output() { static Output self = { nullptr, nullptr, 0 }; return self; }
+
+    // byte by byte where every byte is a call anyway
+    template<class Pipe>
+    static void send(Pipe* pipe, const log_impl::Record& record, task_impl::Tag<false>)
+    {
+        auto sink = [pipe](char c) { pipe->sendByte(c); };
+        Cobs::encode(sink, record.bytes, record.length);
+        sink((char)Cobs::delimiter);
+    }
+    // otherwise encoded on the stack and written in one go, a single copy into the TX ring or a single bulk send
+    template<class Pipe>
+    static void send(Pipe* pipe, const log_impl::Record& record, task_impl::Tag<true>)
+    {
+        struct Encoded
+        {
+            char bytes[Cobs::encodedLength(EVENTLOOP_LOG_RECORD) + 1];
+            uint8_t length;
+            void operator()(char c) { bytes[length++] = c; }
+        } encoded;
+        encoded.length = 0;
+        Cobs::encode(encoded, record.bytes, record.length);
+        encoded((char)Cobs::delimiter);
+        pipe->write(encoded.bytes, encoded.length);
+    }
+    template<class Pipe>
+    static bool fits(Pipe*, const log_impl::Record&, task_impl::Tag<false>) { return true; }
+    template<class Pipe>
+    static bool fits(Pipe* pipe, const log_impl::Record& record, task_impl::Tag<true>)
+    {
+        return pipe->txFree() >= Cobs::encodedLength(record.length) + 1;
+    }
+public:
+    // where the records go from now on, nullptr to nowhere
+    template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+    static void to(PipeIO<Func, tx_size, Bulk>* pipe)
+    {
+        using Pipe = PipeIO<Func, tx_size, Bulk>;
+        output().pipe = pipe;
+        output().write = [](void* p, const log_impl::Record& record) -> bool {
+            Pipe* pipe = (Pipe*)p;
+            if(!fits(pipe, record, task_impl::Tag<(tx_size > 0)>()))
+                return false;
+            send(pipe, record, task_impl::Tag<(tx_size > 0 || pipe_impl::HasBulk<Bulk>::value)>());
+            return true;
+        };
+    }
+    template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+    static void to(PipeIO<Func, tx_size, Bulk>& pipe) { to(&pipe); }
+
+    // what LOG_*() expand to, the format is not used past the compiler
+    template<std::size_t n, typename... Args>
+    static void write(uint16_t id, const char (&)[n], const Args&... args)
+    {
+        Output& out = output();
+        if(!out.pipe)
+            return;
+        log_impl::Record record;
+        record.put((uint8_t)id);
+        record.put((uint8_t)(id >> 8));
+        log_impl::putAll(record, args...);
+        if(record.overflow || !out.write(out.pipe, record))
+            out.dropped++;
+    }
+
+    // records too long or without room in the TX ring, wraps at 65536
+    static uint16_t dropped() { return output().dropped; }
+};
+
+#define LOG_IMPL_FORMAT(format, ...) format
+#define LOG_IMPL_AT(level, ...) do { \
+        static_assert(log_impl::matches(LOG_IMPL_FORMAT(__VA_ARGS__, 0), decltype(log_impl::kinds(__VA_ARGS__))()), \
+                      "the log arguments do not match the format"); \
+        constexpr uint16_t log_id = log_impl::id(level, LOG_IMPL_FORMAT(__VA_ARGS__, 0)); \
+        Log::write(log_id, __VA_ARGS__); \
+    } while(0)
+
+#if EVENTLOOP_LOG_LEVEL <= LOG_LEVEL_DEBUG
+    #define LOG_DEBUG(...) LOG_IMPL_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+    #define LOG_DEBUG(...) do { if(false) LOG_IMPL_AT(LOG_LEVEL_DEBUG, __VA_ARGS__); } while(0)
+#endif
+#if EVENTLOOP_LOG_LEVEL <= LOG_LEVEL_INFO
+    #define LOG_INFO(...) LOG_IMPL_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+    #define LOG_INFO(...) do { if(false) LOG_IMPL_AT(LOG_LEVEL_INFO, __VA_ARGS__); } while(0)
+#endif
+#if EVENTLOOP_LOG_LEVEL <= LOG_LEVEL_WARN
+    #define LOG_WARN(...) LOG_IMPL_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+    #define LOG_WARN(...) do { if(false) LOG_IMPL_AT(LOG_LEVEL_WARN, __VA_ARGS__); } while(0)
+#endif
+#if EVENTLOOP_LOG_LEVEL <= LOG_LEVEL_ERROR
+    #define LOG_ERROR(...) LOG_IMPL_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+    #define LOG_ERROR(...) do { if(false) LOG_IMPL_AT(LOG_LEVEL_ERROR, __VA_ARGS__); } while(0)
+#endif
+
+#endif
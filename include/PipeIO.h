@@ -11,177 +11,505 @@
     #include <string.h>
 #endif
 
-enum class PipeIOFlags : uint8_t
+#include "Platform.h"
+#include "Task.h"
+#include "Format.h"
+
+// where onData cuts the received bytes, see PipeIO::frameLines() etc.
+enum class RxFraming : uint8_t
+{
+    NONE,       // whatever has arrived
+    DELIMITER,  // up to a delimiter, which is left out
+    FIXED,      // a fixed number of bytes
+    PREDICATE,  // up to the byte a function says ends the frame, which is kept
+};
+
+// received bytes in the RX ring, in two pieces when they wrap around its end. only valid until they are consumed
+struct RxSpan
 {
-    NONE    = 0,
-    ONDATA  = 1,
-    ONFULL  = 2,
-    RECVBUSY= 4,
+    const char* first;
+    const char* second;
+    uint8_t first_length;
+    uint8_t second_length;
+
+    RxSpan(const char* first=nullptr, uint8_t first_length=0, const char* second=nullptr, uint8_t second_length=0) :
+    first(first), second(second), first_length(first_length), second_length(second_length) {}
+
+    uint8_t length() const { return first_length + second_length; }
+    explicit operator bool() const { return length() != 0; }
+    char operator[](uint8_t i) const { return i < first_length ? first[i] : second[i - first_length]; }
+    // copies at most size bytes to out, returns how many
+    uint8_t copyTo(char* out, uint8_t size) const
+    {
+        const uint8_t a = first_length < size ? first_length : size;
+        const uint8_t b = second_length < size - a ? second_length : size - a;
+        if(a)
+            memcpy(out, first, a);
+        if(b)
+            memcpy(out + a, second, b);
+        return a + b;
+    }
 };
 
 using BlockingSendByteFunc = void (*)(char);
-template<BlockingSendByteFunc Func>
-class PipeIO
+// moves length bytes in one go: a host write(2), or the start of a DMA transfer that ends in the TX ISR
+using BulkSendFunc = void (*)(const char* data, std::size_t length);
+
+// bytes to write, one of the pieces of PipeIO::writev()
+struct TxSpan
+{
+    const void* data;
+    std::size_t length;
+};
+
+namespace pipe_impl
+{
+
+// whether a PipeIO has a bulk sender. not Bulk != nullptr, which is no constant for weak symbols under sanitizers
+template<BulkSendFunc Bulk> struct HasBulk { static constexpr bool value = true; };
+template<> struct HasBulk<nullptr> { static constexpr bool value = false; };
+
+// the transmit ring of an asynchronous PipeIO, single producer (the writer) single consumer (the TX ISR).
+// the indexes are single bytes published with acquire/release builtins, plain loads/stores on avr
+template<std::size_t tx_size, class Pipe>
+class TxRing
+{
+static_assert(tx_size < 0xFF, "PipeIO: tx_size must be in range [0, 254]");
+protected:
+    static constexpr uint8_t storage_count = tx_size+1;    // one byte is always free to tell full from empty
+    char m_ring[storage_count];
+    uint8_t m_head = 0;     // written by the TX ISR only
+    uint8_t m_tail = 0;     // written by the writer only
+    uint8_t m_dropped = 0;  // written by the writer only
+    uint8_t m_in_flight = 0;    // bytes handed to a bulk sender, freed when it is done, ISR or critical sections only
+    bool m_busy = false;    // a byte is on the wire, written in critical sections or the ISR only
+
+    static uint8_t following(uint8_t i) { return i+1 < storage_count ? i+1 : 0; }
+    bool push(char c)
+    {
+        const uint8_t tail = m_tail;
+        const uint8_t next = following(tail);
+        if(next == __atomic_load_n(&m_head, __ATOMIC_ACQUIRE))
+        {
+            m_dropped++;
+            return false;
+        }
+        m_ring[tail] = c;
+        __atomic_store_n(&m_tail, next, __ATOMIC_RELEASE);
+        return true;
+    }
+    // copies what fits and drops the rest, one release for all of it
+    void pushAll(const char* data, std::size_t length)
+    {
+        const uint8_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        const uint8_t tail = m_tail;
+        const uint8_t room = head > tail ? head - tail - 1 : tx_size - tail + head;
+        const uint8_t n = length < room ? length : room;
+        const uint8_t first = n < storage_count - tail ? n : storage_count - tail;
+        memcpy(m_ring + tail, data, first);
+        memcpy(m_ring, data + first, n - first);
+        m_dropped += length - n;
+        __atomic_store_n(&m_tail, (uint8_t)(tail + n < storage_count ? tail + n : tail + n - storage_count), __ATOMIC_RELEASE);
+    }
+    bool pop(char& c)
+    {
+        const uint8_t head = m_head;
+        if(head == __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE))
+            return false;
+        c = m_ring[head];
+        __atomic_store_n(&m_head, following(head), __ATOMIC_RELEASE);
+        return true;
+    }
+    // the pending bytes up to the end of the storage, they stay in the ring until release()
+    uint8_t run(const char*& data) const
+    {
+        const uint8_t head = m_head;
+        const uint8_t tail = __atomic_load_n(&m_tail, __ATOMIC_ACQUIRE);
+        data = m_ring + head;
+        return tail >= head ? tail - head : storage_count - head;
+    }
+    void release(uint8_t length)
+    {
+        const uint8_t head = m_head;
+        __atomic_store_n(&m_head, (uint8_t)(head + length < storage_count ? head + length : head + length - storage_count), __ATOMIC_RELEASE);
+    }
+public:
+    // called in the TX ISR once the last byte is out, post() the next writer to the loop from here
+    void (*onDrain)(Pipe*) = nullptr;
+
+    // bytes that can be written without any dropped, check it to write a message whole
+    std::size_t txFree() const
+    {
+        const uint8_t head = __atomic_load_n(&m_head, __ATOMIC_ACQUIRE);
+        return head > m_tail ? head - m_tail - 1 : tx_size - m_tail + head;
+    }
+    std::size_t txPending() const { return tx_size - txFree(); }
+    bool txBusy() const { return __atomic_load_n(&m_busy, __ATOMIC_ACQUIRE); }
+    // bytes dropped on a full ring since constructed, wraps at 256
+    uint8_t txDropped() const { return m_dropped; }
+};
+
+// the blocking PipeIO sends in place and keeps nothing
+template<class Pipe>
+class TxRing<0, Pipe> {};
+
+// the sink of the Format.h functions: byte by byte where every byte is a call anyway,
+// otherwise collected and written in pieces, one bulk send or one ring copy each
+template<class Pipe, bool buffered>
+struct FormatSink
+{
+    Pipe* self;
+    void operator()(char c) { self->sendByte(c); }
+};
+template<class Pipe>
+struct FormatSink<Pipe, true>
+{
+    Pipe* self;
+    char buffer[24];
+    uint8_t length = 0;
+
+    explicit FormatSink(Pipe* self) : self(self) {}
+    ~FormatSink()
+    {
+        if(length)
+            self->write(buffer, length);
+    }
+    void operator()(char c)
+    {
+        if(length == sizeof(buffer))
+        {
+            self->write(buffer, length);
+            length = 0;
+        }
+        buffer[length++] = c;
+    }
+};
+
+};
+
+/*
+    PipeIO<Func> sends every byte through Func in place, which waits for the uart, e.g. spinning on UDRE0.
+    PipeIO<Func, tx_size> is asynchronous: operator<< and the send functions only copy into a ring of tx_size bytes.
+    The first byte written to an idle transmitter goes to Func at once (so Func never waits), the rest are handed
+    to Func by txEmpty(), the hook for the TX complete ISR, e.g. ISR(USART_TX_vect) on avr. Nothing blocks: a byte
+    that finds the ring full is dropped and counted, txFree() tells whether a message fits before writing it,
+    and onDrain runs in the ISR once the ring has emptied.
+    PipeIO<Func, tx_size, Bulk> also has a bulk sender, for a backend that moves a buffer in one operation:
+    the blocking one hands write(), sendString() and formatted numbers to Bulk whole, e.g. fdWrite<fd> on a host.
+    The asynchronous one hands Bulk what is pending in the ring up to its end, e.g. to start a DMA transfer,
+    and txEmpty() is then the hook for its transfer complete interrupt, which frees those bytes and starts the next.
+    Func is still what sendByte() uses on the blocking one, Bulk must not call txEmpty() before it returns.
+    write() takes any bytes, 0s included, writev() several pieces of them, e.g. a header, a payload and a checksum,
+    copied into the ring before the transmitter is started once.
+
+    Receiving goes through a ring over the buffer given to the constructor (at most 255 bytes, one stays free),
+    single producer single consumer like the TX one: the RX ISR calls receive(c), which never waits and drops and
+    counts a byte only when the ring is full. onData gets the bytes cut into frames by frameLines(), frameFixed() or
+    frameBy() as an RxSpan pointing into the ring, no copy, consumed when it returns.
+    After dispatchOn(eventloop) onData runs in the passes of the loop, posted once for any number of bytes,
+    without it in the ISR. Pulling with rxPeek()/rxConsume() instead works as well, e.g. after eventloop.waitData().
+*/
+template<BlockingSendByteFunc Func, std::size_t tx_size = 0, BulkSendFunc Bulk = nullptr>
+class PipeIO : public pipe_impl::TxRing<tx_size, PipeIO<Func, tx_size, Bulk>>
 {
 private:
-    char *m_buffer = nullptr;
-    char *m_prev = nullptr;
-    std::size_t m_capacity = 0;
-    std::size_t m_length = 0;
-    uint8_t m_flags = 0;
+    char *m_rx;
+    uint8_t m_rx_size;              // bytes of the ring, one is always free
+    uint8_t m_rx_head = 0;          // written by the consumer only
+    uint8_t m_rx_tail = 0;          // written by the RX ISR only
+    uint8_t m_rx_scanned = 0;       // bytes after the head already searched for the end of a frame, consumer only
+    uint8_t m_rx_dropped = 0;       // written by the RX ISR only
+    bool m_rx_posted = false;       // a dispatch is on its way to the loop
+    RxFraming m_framing = RxFraming::NONE;
+    char m_delimiter = '\n';
+    uint8_t m_frame_length = 0;
+    bool (*m_frame_end)(char c, uint8_t index) = nullptr;
+    void* m_loop = nullptr;
+    bool (*m_post)(void* loop, PipeIO* self) = nullptr;
+
+    void sendByte(char c, task_impl::Tag<false>) { Func(c); }
+    void sendByte(char c, task_impl::Tag<true>);
+    // the blocking one sends in place, with or without Bulk
+    void put(const char* data, std::size_t length, task_impl::Tag<false>, task_impl::Tag<false>)
+    {
+        for(std::size_t i=0; i<length; i++)
+            Func(data[i]);
+    }
+    void put(const char* data, std::size_t length, task_impl::Tag<false>, task_impl::Tag<true>) { Bulk(data, length); }
+    template<bool bulk>
+    void put(const char* data, std::size_t length, task_impl::Tag<true>, task_impl::Tag<bulk>) { this->pushAll(data, length); }
+    void put(const char* data, std::size_t length)
+    {
+        put(data, length, task_impl::Tag<(tx_size > 0)>(), task_impl::Tag<pipe_impl::HasBulk<Bulk>::value>());
+    }
+    // hands the next pending bytes to the transmitter, false when there are none
+    bool sendNext(task_impl::Tag<false>)
+    {
+        char c;
+        if(!this->pop(c))
+            return false;
+        Func(c);
+        return true;
+    }
+    bool sendNext(task_impl::Tag<true>)
+    {
+        this->release(this->m_in_flight);   // 0 when the transmitter was idle
+        const char* data;
+        this->m_in_flight = this->run(data);
+        if(!this->m_in_flight)
+            return false;
+        Bulk(data, this->m_in_flight);
+        return true;
+    }
+    // the writer starts an idle transmitter itself, once running the ISR keeps it going
+    void start(task_impl::Tag<false>) {}
+    void start(task_impl::Tag<true>)
+    {
+        CriticalSection guard;
+        if(!this->m_busy && sendNext(task_impl::Tag<pipe_impl::HasBulk<Bulk>::value>()))
+            __atomic_store_n(&this->m_busy, true, __ATOMIC_RELEASE);
+    }
+
+    using Sink = pipe_impl::FormatSink<PipeIO, (tx_size > 0 || pipe_impl::HasBulk<Bulk>::value)>;
+    uint8_t frameEnd(uint8_t available);
+    static void dispatchTask(PipeIO* self) { self->dispatch(); }
 public:
     PipeIO(char *buf, std::size_t capacity) : 
-    m_buffer(buf), 
-    m_prev(buf),
-    m_capacity(capacity)
+    m_rx(buf), 
+    m_rx_size(capacity < 0xFF ? capacity : 0xFF)
     {}
     // events callbacks
-    void (*onData)(PipeIO*, char*) = nullptr;   // ondata callback is expected to reset the ondata flag
-    void (*onFull)(PipeIO*) = nullptr;  // onfull callback is expected to clear the buffer and reset the onfull flag
+    void (*onData)(PipeIO*, const RxSpan&) = nullptr;  // a frame has arrived, see the framing functions
+    TaskInterface* onDataEvent = nullptr;   // a bound event handler exec()'d in the RX ISR on every byte, e.g. eventloop.waitData()
 
+    // onData runs in the passes of loop rather than in the RX ISR, which then is the producer of loop.post()
+    template<class Loop>
+    void dispatchOn(Loop& loop)
+    {
+        m_loop = &loop;
+        m_post = [](void* loop, PipeIO* self){ return static_cast<Loop*>(loop)->post(dispatchTask, self); };
+    }
+
+    // framing of onData, set before receiving. frames longer than the ring are cut at its size
+    void frameNone() { m_framing = RxFraming::NONE; }
+    void frameLines(char delimiter='\n') { m_framing = RxFraming::DELIMITER; m_delimiter = delimiter; }
+    void frameFixed(uint8_t length) { m_framing = RxFraming::FIXED; m_frame_length = length; }
+    // end(c, index) tells whether c, the index-th byte of the frame, is its last one
+    void frameBy(bool (*end)(char c, uint8_t index)) { m_framing = RxFraming::PREDICATE; m_frame_end = end; }
+
+    // the RX ISR hook: c has been received
+    bool receive(char c);
+    // what receive() does after storing a byte: exec() onDataEvent and dispatch onData, or post the dispatch
     void checkEvents();
+    // hands every complete frame to onData and consumes it, in the loop after dispatchOn()
+    void dispatch();
 
-    // properties functions
-    char *buffer() { return m_buffer; }
-    std::size_t capacity() { return m_capacity; }
-    std::size_t length() { return m_length; }
-    uint8_t& flags() { return m_flags; }
+    // the consumer side, from the one context that consumes
+    uint8_t rxAvailable() const
+    {
+        const uint8_t tail = __atomic_load_n(&m_rx_tail, __ATOMIC_ACQUIRE);
+        return tail >= m_rx_head ? tail - m_rx_head : m_rx_size - m_rx_head + tail;
+    }
+    RxSpan rxPeek(uint8_t length=0xFF) const;
+    void rxConsume(uint8_t length);
+    uint8_t rxCapacity() const { return m_rx_size ? m_rx_size - 1 : 0; }
+    // bytes dropped on a full ring since constructed, wraps at 256
+    uint8_t rxDropped() const { return m_rx_dropped; }
 
     // output functions
-    void sendByte(char c) { Func(c); }
-    void sendString(const char *str);
-    void sendInt32(int32_t number, bool hex=false);
-    void sendInt64(int64_t number, bool hex=false);
-    void sendFloat(float number, uint8_t decimals=2);
-    PipeIO<Func>& operator<<(const char c) { sendByte(c); return *this; }
-    PipeIO<Func>& operator<<(bool b) { sendByte(b+'0'); return *this; }
-    PipeIO<Func>& operator<<(const char *str) { sendString(str); return *this; }
-    PipeIO<Func>& operator<<(int32_t number) { sendInt32(number); return *this; }
-    PipeIO<Func>& operator<<(int64_t number) { sendInt64(number); return *this; }
-    PipeIO<Func>& operator<<(float number) { sendFloat(number); return *this; }
-    PipeIO<Func>& operator<<(void* address) { sendInt32((int32_t)address, true); return *this; }
+    void sendByte(char c) { sendByte(c, task_impl::Tag<(tx_size > 0)>()); }
+    void sendString(const char *str) { write(str, strlen(str)); }
+    void write(const void* data, std::size_t length)
+    {
+        put((const char*)data, length);
+        start(task_impl::Tag<(tx_size > 0)>());
+    }
+    void writev(const TxSpan* spans, uint8_t count)
+    {
+        for(uint8_t i=0; i<count; i++)
+            put((const char*)spans[i].data, spans[i].length);
+        start(task_impl::Tag<(tx_size > 0)>());
+    }
+    template<uint8_t count>
+    void writev(const TxSpan (&spans)[count]) { writev(spans, count); }
+    void sendInt32(int32_t number, bool hex=false) { sendInt32(number, hex ? NumberFormat::hex() : NumberFormat()); }
+    void sendInt64(int64_t number, bool hex=false) { sendInt64(number, hex ? NumberFormat::hex() : NumberFormat()); }
+    void sendInt32(int32_t number, const NumberFormat& format) { Sink sink{this}; formatInteger(sink, number, format); }
+    void sendInt64(int64_t number, const NumberFormat& format) { Sink sink{this}; formatInteger(sink, number, format); }
+    void sendUInt32(uint32_t number, const NumberFormat& format=NumberFormat()) { Sink sink{this}; formatInteger(sink, number, format); }
+    void sendUInt64(uint64_t number, const NumberFormat& format=NumberFormat()) { Sink sink{this}; formatInteger(sink, number, format); }
+    void sendFloat(float number, uint8_t decimals=2, const NumberFormat& format=NumberFormat())
+    { Sink sink{this}; formatFloat(sink, number, decimals, format); }
+    // scaled/10^decimals, e.g. sendDecimal(2350, 2) for millivolts as "23.50"
+    void sendDecimal(int32_t scaled, uint8_t decimals, const NumberFormat& format=NumberFormat())
+    { Sink sink{this}; formatDecimal(sink, scaled, decimals, format); }
+    // a binary fixed point number with frac_bits of fraction, e.g. sendFixed(q, 16, 3) for Q16.16
+    void sendFixed(int32_t q, uint8_t frac_bits, uint8_t decimals, const NumberFormat& format=NumberFormat())
+    { Sink sink{this}; formatFixed(sink, q, frac_bits, decimals, format); }
+    PipeIO& operator<<(const char c) { sendByte(c); return *this; }
+    PipeIO& operator<<(bool b) { sendByte(b+'0'); return *this; }
+    PipeIO& operator<<(const char *str) { sendString(str); return *this; }
+    PipeIO& operator<<(int32_t number) { sendInt32(number); return *this; }
+    PipeIO& operator<<(int64_t number) { sendInt64(number); return *this; }
+    PipeIO& operator<<(uint32_t number) { sendUInt32(number); return *this; }
+    PipeIO& operator<<(uint64_t number) { sendUInt64(number); return *this; }
+    PipeIO& operator<<(float number) { sendFloat(number); return *this; }
+    PipeIO& operator<<(void* address)
+    {
+        if(sizeof(void*) > sizeof(uint32_t))
+            sendUInt64((uintptr_t)address, NumberFormat::hex());
+        else
+            sendUInt32((uintptr_t)address, NumberFormat::hex());
+        return *this;
+    }
     
-    // input functions
-    bool buffer_push(char c);
-    char buffer_pop();
-    void buffer_clear();
+    // the TX ISR hook of the asynchronous PipeIO: the transmitter is empty and takes the next byte,
+    // or with Bulk the transfer is complete and takes the next run of bytes
+    void txEmpty();
+    // wait until everything written is out, interrupts must be on
+    void flush() { while(this->txBusy()) {} }
 };
 
-
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::sendString(const char *str)
-{ 
-    while(*str) 
-        sendByte(*str++); 
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void PipeIO<Func, tx_size, Bulk>::sendByte(char c, task_impl::Tag<true>)
+{
+    if(this->push(c))
+        start(task_impl::Tag<true>());
 }
 
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::sendInt32(int32_t number, bool hex)
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void PipeIO<Func, tx_size, Bulk>::txEmpty()
 {
-    if(number < 0)
-    {
-        sendByte('-');
-        number = -number;
-    }
-    if(hex)
-        sendString("0x");
-    char buffer[12] = {0};
-    char *ptr = buffer + sizeof(buffer) - 1;
-    *ptr = '\0';
-    do
-    {
-        *--ptr = "0123456789ABCDEF"[number % (hex? 16:10)];
-        number /= 10;
-    } while(number);
-    sendString(ptr);
+    if(!this->m_busy)
+        return;
+    if(sendNext(task_impl::Tag<pipe_impl::HasBulk<Bulk>::value>()))
+        return;
+    __atomic_store_n(&this->m_busy, false, __ATOMIC_RELEASE);
+    if(this->onDrain)
+        this->onDrain(this);
 }
 
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::sendInt64(int64_t number, bool hex)
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+bool PipeIO<Func, tx_size, Bulk>::receive(char c)
 {
-    if(number < 0)
+    const uint8_t head = __atomic_load_n(&m_rx_head, __ATOMIC_ACQUIRE);
+    const uint8_t tail = m_rx_tail;
+    const uint8_t next = tail+1 < m_rx_size ? tail+1 : 0;
+    const bool stored = next != head;
+    if(stored)
     {
-        sendByte('-');
-        number = -number;
+        m_rx[tail] = c;
+        __atomic_store_n(&m_rx_tail, next, __ATOMIC_SEQ_CST);
     }
-    if(hex)
-        sendString("0x");
-    char buffer[24] = {0};
-    char *ptr = buffer + sizeof(buffer) - 1;
-    *ptr = '\0';
-    do
-    {
-        *--ptr = "0123456789ABCDEF"[number % (hex? 16:10)];
-        number /= 10;
-    } while(number);
-    sendString(ptr);
+    else
+        m_rx_dropped++;
+    // lines are posted once they end or fill the ring, everything else on every byte
+    const bool full = !stored || (next+1 < m_rx_size ? next+1 : 0) == head;
+    if(m_framing != RxFraming::DELIMITER || c == m_delimiter || full)
+        checkEvents();
+    else if(onDataEvent)
+        onDataEvent->exec();
+    return stored;
 }
 
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::sendFloat(float number, uint8_t decimals)
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void PipeIO<Func, tx_size, Bulk>::checkEvents()
 {
-    sendInt32((int32_t)number);
-    int32_t tens = 1;
-    number = number<0? -number:number;
-    for(int i=0; i<decimals; i++)
+    if(onDataEvent)
+        onDataEvent->exec();
+    if(!onData)
+        return;
+    if(!m_post)
+        return dispatch();
+    // set before posting: the dispatch may run before post() returns on a host
+    bool posted;
     {
-        tens *= 10;
-        number *= 10;
+#ifndef PLATFORM_AVR
+        CriticalSection guard;  // the RX ISR of avr runs with interrupts off already
+#endif
+        posted = m_rx_posted;
+        m_rx_posted = true;
     }
-    sendByte('.');
-    sendInt32((int32_t)number%tens);
+    if(!posted && !m_post(m_loop, this))
+        __atomic_store_n(&m_rx_posted, false, __ATOMIC_SEQ_CST);    // the queue was full, the next byte tries again
 }
 
-template<BlockingSendByteFunc Func>
-bool PipeIO<Func>::buffer_push(char c)
+// bytes of the next frame including its end, 0 if it is not complete yet
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+uint8_t PipeIO<Func, tx_size, Bulk>::frameEnd(uint8_t available)
 {
-    m_flags |= (uint8_t)PipeIOFlags::ONDATA;
-    if(m_length < m_capacity)
+    switch(m_framing)
     {
-        m_buffer[m_length++] = c;
-        return true;
+    case RxFraming::NONE:
+        return available;
+    case RxFraming::FIXED:
+        return available >= m_frame_length ? m_frame_length : 0;
+    default:
+        break;
     }
-    else
+    uint8_t i = m_rx_scanned;
+    uint16_t at = m_rx_head + i;
+    for(; i < available; i++, at++)
     {
-        m_flags |= (uint8_t)PipeIOFlags::ONFULL;
-        return false;
+        if(at >= m_rx_size)
+            at -= m_rx_size;
+        const char c = m_rx[at];
+        if(m_framing == RxFraming::DELIMITER ? c == m_delimiter : m_frame_end(c, i))
+            return i+1;
     }
+    m_rx_scanned = available;
+    return 0;
 }
 
-template<BlockingSendByteFunc Func>
-char PipeIO<Func>::buffer_pop()
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void PipeIO<Func, tx_size, Bulk>::dispatch()
 {
-    if(m_length > 0)
     {
-        char c = m_buffer[m_length-1];
-        m_buffer[m_length-1] = '\0';
-        m_length--;
-        return c;
+#ifndef PLATFORM_AVR
+        CriticalSection guard;  // not in between the test and set of checkEvents()
+#endif
+        __atomic_store_n(&m_rx_posted, false, __ATOMIC_SEQ_CST);   // bytes stored from here on post again
+    }
+    while(uint8_t available = rxAvailable())
+    {
+        uint8_t length = frameEnd(available);
+        uint8_t cut = m_framing == RxFraming::DELIMITER;
+        if(!length)
+        {
+            if(available < rxCapacity())
+                return;
+            length = available;     // the ring is full of one frame
+            cut = 0;
+        }
+        if(onData)
+            onData(this, rxPeek(length - cut));
+        rxConsume(length);
     }
-    else
-        return 0;
 }
 
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::buffer_clear()
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+RxSpan PipeIO<Func, tx_size, Bulk>::rxPeek(uint8_t length) const
 {
-    m_length = 0;
-    memset(m_buffer, 0, m_capacity);
-    m_flags = 0;
+    const uint8_t available = rxAvailable();
+    if(length > available)
+        length = available;
+    const uint8_t to_end = m_rx_size - m_rx_head;
+    if(length <= to_end)
+        return RxSpan(m_rx + m_rx_head, length);
+    return RxSpan(m_rx + m_rx_head, to_end, m_rx, length - to_end);
 }
 
-template<BlockingSendByteFunc Func>
-void PipeIO<Func>::checkEvents()
+template<BlockingSendByteFunc Func, std::size_t tx_size, BulkSendFunc Bulk>
+void PipeIO<Func, tx_size, Bulk>::rxConsume(uint8_t length)
 {
-    if(m_flags & (uint8_t)PipeIOFlags::ONDATA && onData)
-    {
-        onData(this, m_prev);
-        m_prev = m_buffer+m_length; // update the previous pointer
-    }
-    if(m_flags & (uint8_t)PipeIOFlags::ONFULL && onFull)
-    {
-        onFull(this);
-    }
+    const uint8_t available = rxAvailable();
+    if(length > available)
+        length = available;
+    uint16_t head = m_rx_head + length;
+    if(head >= m_rx_size)
+        head -= m_rx_size;
+    m_rx_scanned = m_rx_scanned > length ? m_rx_scanned - length : 0;
+    __atomic_store_n(&m_rx_head, (uint8_t)head, __ATOMIC_RELEASE);
 }
 
 #endif
\ No newline at end of file
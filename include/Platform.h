@@ -0,0 +1,214 @@
+#ifndef __PLATFORM_H__
+    #define __PLATFORM_H__
+
+/*
+    Platform: the few things the core headers need from the machine they run on.
+    - CriticalSection: RAII guard, nothing that touches ISR shared state may interleave with it
+    - platformMillis() / platformMicros(): the free running clock of the platform, only the host has one,
+      on avr the timer ISR drives Time::tick() instead
+    - PlatformWakeup: the wakeup flag of a loop, set() cuts the idle hook of that loop short from another context
+    - host only: stand-ins for the uart of PipeIO, a file descriptor as is or SimulatedUart at a baud rate
+    avr is chosen by the compiler, everything else is treated as a POSIX host, which needs the full stdc++ library.
+*/
+
+#if defined(__AVR__)
+    #define PLATFORM_AVR
+#else
+    #define PLATFORM_POSIX
+#endif
+
+#ifdef PLATFORM_AVR
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// same as ATOMIC_BLOCK(ATOMIC_RESTORESTATE), the interrupt flag is restored rather than set
+class CriticalSection
+{
+private:
+    uint8_t m_sreg;
+public:
+    CriticalSection() : m_sreg(SREG) { cli(); }
+    ~CriticalSection() { SREG = m_sreg; }
+    CriticalSection(const CriticalSection&) = delete;
+};
+
+inline uint64_t platformMillis() { return 0; }
+inline uint64_t platformMicros() { return 0; }
+
+// any interrupt wakes the cpu up already, the flag is all there is. one byte is read and written at once
+struct PlatformWakeup
+{
+    volatile uint8_t flag = 0;
+    void set() { flag = 1; }
+    void clear() { flag = 0; }
+};
+
+#else   // PLATFORM_POSIX
+
+#ifndef USE_STDCPP_LIB
+    #error "Platform: host builds need the full stdc++ library, define USE_STDCPP_LIB"
+#endif
+
+#include <cstdint>
+#include <type_traits>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+// the wakeup flag of a loop and what its thread waits on while idle, the "ISRs" of a host are other threads.
+// every loop has its own, so a set() only wakes the loop it is meant for, and only the first one after a clear() notifies
+struct PlatformWakeup
+{
+    volatile uint8_t flag = 0;  // the idle hook is handed this, of() finds the rest from it
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    void set()
+    {
+        if(__atomic_exchange_n(&flag, 1, __ATOMIC_ACQ_REL))
+            return;     // set already, the sleeper has been notified or has not gone to sleep yet
+        { std::lock_guard<std::mutex> guard(mutex); }   // a sleeper between checking the flag and waiting cannot miss it
+        cond.notify_one();
+    }
+    // what was posted before the last set() is visible after this
+    void clear() { __atomic_exchange_n(&flag, 0, __ATOMIC_ACQUIRE); }
+    static PlatformWakeup& of(const volatile uint8_t& flag)
+    {
+        static_assert(std::is_standard_layout<PlatformWakeup>::value, "PlatformWakeup: the flag must be at its address");
+        return *reinterpret_cast<PlatformWakeup*>(const_cast<uint8_t*>(&flag));
+    }
+};
+
+// one global lock stands in for disabling interrupts, recursive since guarded code may nest on avr too
+class CriticalSection
+{
+private:
+    static std::recursive_mutex& lock() { static std::recursive_mutex self; return self; }
+public:
+    CriticalSection() { lock().lock(); }
+    ~CriticalSection() { lock().unlock(); }
+    CriticalSection(const CriticalSection&) = delete;
+};
+
+// us since the first call, from the monotonic clock so wall clock adjustments never move the loop
+inline uint64_t platformMicros()
+{
+    using namespace std::chrono;
+    static const steady_clock::time_point boot = steady_clock::now();
+    return duration_cast<microseconds>(steady_clock::now() - boot).count();
+}
+inline uint64_t platformMillis() { return platformMicros()/1000; }
+
+// stand-ins for the uart of PipeIO<BlockingSendByteFunc>: any file descriptor, e.g. one end of a pipe
+template<int fd>
+void fdSendByte(char c)
+{
+    while(write(fd, &c, 1) < 0 && errno == EINTR) {}
+}
+inline void stdoutSendByte(char c) { fdSendByte<STDOUT_FILENO>(c); }
+// the bulk sender of PipeIO<fdSendByte<fd>, 0, fdWrite<fd>>, one write(2) for a whole buffer
+template<int fd>
+void fdWrite(const char* data, std::size_t length)
+{
+    while(length)
+    {
+        const ssize_t n = write(fd, data, length);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return;
+        data += n;
+        length -= n;
+    }
+}
+inline void stdoutWrite(const char* data, std::size_t length) { fdWrite<STDOUT_FILENO>(data, length); }
+
+/*
+    a uart at a given baud rate in front of a file descriptor, the wire is a thread. send() writes the data register,
+    it waits while the register is full as spinning on UDRE0 does, the shift register empties it at the start of
+    every byte, so a polling sender keeps the wire busy. Every byte takes 10 bit times, bytes follow each other on
+    the absolute schedule of the baud rate however late the thread wakes up. When the last one is out the TX complete
+    "ISR" runs on the wire thread in a CriticalSection, a byte it sends goes out right after the one before.
+    PipeIO<simulatedSendByte<uart>> blocks the way a polled uart does, PipeIO<simulatedSendByte<uart>, N> with
+    uart.onTxComplete([](){ pipe.txEmpty(); }) runs off the ISR.
+*/
+class SimulatedUart
+{
+private:
+    using Clock = std::chrono::steady_clock;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    const int m_fd;
+    const std::chrono::nanoseconds m_byte_time;
+    void (*m_tx_complete)() = nullptr;
+    Clock::time_point m_written;    // when the data register was written
+    char m_data = 0;
+    bool m_full = false;
+    bool m_stop = false;
+    std::thread m_wire;
+
+    void wire()
+    {
+        Clock::time_point next = Clock::now();     // the end of the byte on the wire
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(true)
+        {
+            m_cond.wait(lock, [this](){ return m_full || m_stop; });
+            if(!m_full)
+                return;
+            const char c = m_data;
+            m_full = false;     // into the shift register
+            m_cond.notify_all();
+            next = std::max(next, m_written) + m_byte_time;
+            lock.unlock();
+            std::this_thread::sleep_until(next);
+            while(write(m_fd, &c, 1) < 0 && errno == EINTR) {}
+            lock.lock();
+            void (*isr)() = m_tx_complete;
+            if(m_full || !isr)
+                continue;
+            lock.unlock();
+            { CriticalSection guard; isr(); }
+            lock.lock();
+            if(m_full)
+                m_written = next;
+        }
+    }
+public:
+    SimulatedUart(int fd, uint32_t baud) : m_fd(fd), m_byte_time(10*1000000000ULL/baud), m_wire([this](){ wire(); }) {}
+    ~SimulatedUart()
+    {
+        { std::lock_guard<std::mutex> guard(m_mutex); m_stop = true; }
+        m_cond.notify_all();
+        m_wire.join();
+    }
+    SimulatedUart(const SimulatedUart&) = delete;
+
+    void onTxComplete(void (*isr)()) { std::lock_guard<std::mutex> guard(m_mutex); m_tx_complete = isr; }
+    void send(char c)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this](){ return !m_full; });
+        m_data = c;
+        m_full = true;
+        m_written = Clock::now();
+        m_cond.notify_all();
+    }
+};
+template<SimulatedUart& uart>
+void simulatedSendByte(char c) { uart.send(c); }
+
+#endif
+
+#endif
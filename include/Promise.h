@@ -0,0 +1,495 @@
+#ifndef __PROMISE_H__
+    #define __PROMISE_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+    #include <tuple>
+    #include <utility>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Task.h"
+
+/*
+    Promise<T>: a value that arrives later. The continuation attached with then() runs in the loop once
+    the value is there, and then() returns the promise of what the continuation returns, so a flow of
+    several asynchronous steps is a chain instead of nested nextTick()/setTimeout() calls.
+    The values and continuations live in the fixed slots of a PromisePool, one slot per promise:
+    - resolve() moves the value into the slot, and the continuation moves it out again, so a chain carries its value
+      forward by move. The continuation itself is moved into the slot once, by then().
+    - a promise settles by queueing exactly ONE small task, (pool, slot index). It runs the continuation and frees the slot.
+    - a continuation returning a Promise<U> is unwrapped, the promise then() returned settles with the U of the inner one.
+    - a continuation returning nothing gives a Promise<PromiseVoid>.
+    A promise takes ONE continuation; then(), all() and any() all attach it. Promise<T> is only a handle, like TaskHandle,
+    and it goes stale once its continuation has run. Nothing throws. A full pool, a continuation too large for a slot, or
+    a loop that cannot take the task make then()/all()/any() return an invalid promise (false), and resolve() return false.
+    then() and resolve() leave the promise as it was then, they can be tried again. Inside a chain the same failure ends it,
+    the promises downstream are given back and go stale. The loop reports the task it could not take to onTaskAllocationFailed.
+    Everything runs in the loop context, the same as nextTick(). Use post() to get out of an ISR first.
+*/
+
+struct PromiseVoid {};
+
+template<typename T>
+class Promise;
+
+namespace promise_impl
+{
+    // values and continuations are constructed in the slots through this, avr has no global placement new
+    template<typename T>
+    struct Boxed
+    {
+        static_assert(alignof(T) <= TaskAlignment, "Promise: the value or the continuation is over aligned");
+        T value;
+        template<typename ...Args>
+        Boxed(Args&&... args) : value(std::forward<Args>(args)...) {}
+        void* operator new(std::size_t, void* ptr) { return ptr; }
+        void operator delete(void*, void*) {}
+    };
+
+    constexpr std::size_t aligned(std::size_t size) { return (size + TaskAlignment-1) / TaskAlignment * TaskAlignment; }
+
+    template<typename T>
+    T& unbox(void* p) { return static_cast<Boxed<T>*>(p)->value; }
+    template<typename T>
+    void destroy(void* p) { static_cast<Boxed<T>*>(p)->~Boxed(); }
+
+    // a continuation of the pool itself gives back the promise it would have settled when it is dropped unrun,
+    // so a chain broken in the middle frees its slots down to the end. one of the user's has nothing to give back
+    template<typename C>
+    auto abandon(C& continuation, int) -> decltype(continuation.abandon()) { continuation.abandon(); }
+    template<typename C>
+    void abandon(C&, long) {}
+
+    // the continuation is stored right after the value
+    template<typename T>
+    constexpr std::size_t continuationOffset() { return aligned(sizeof(Boxed<T>)); }
+
+    // what then() returns a promise of
+    template<typename R>
+    struct Settled { using type = R; static constexpr bool unwrap = false; };
+    template<>
+    struct Settled<void> { using type = PromiseVoid; static constexpr bool unwrap = false; };
+    template<typename U>
+    struct Settled<Promise<U>> { using type = U; static constexpr bool unwrap = true; };
+
+    template<typename F, typename T>
+    using Result = decltype(std::declval<F>()(std::declval<T>()));
+}
+
+/*
+    The part of PromisePool that Promise<T> needs, it does not depend on the loop or the sizes.
+    The headers and the storage of the slots are two arrays of the derived pool.
+*/
+class PromisePoolBase
+{
+template<typename T> friend class Promise;
+template<class Loop, std::size_t slot_count, std::size_t slot_size> friend class PromisePool;
+protected:
+    enum Flags : uint8_t
+    {
+        BUSY    = 1,
+        VALUE   = 2,    // the value is constructed
+        SETTLED = 4,    // the value is final, the continuation can run
+        CHAINED = 8,    // a continuation is attached
+        QUEUED  = 16,   // the task running the continuation is in the loop
+        DROPPED = 32,   // only passed to Slot::destroy, the continuation never ran
+    };
+    struct Slot
+    {
+        void (*run)(void* bytes);   // move the value into the continuation, then destroy both
+        void (*destroy)(void* bytes, uint8_t flags);    // destroy what is constructed, the slot is dropped
+        uint8_t flags;
+        uint8_t generation;
+        uint8_t count;  // free: the next free slot, all(): the promises still to settle
+    };
+    static constexpr uint8_t NoSlot = 0xFF;
+
+    Slot* m_slots;
+    char* m_storage;
+    uint16_t m_slot_size;
+    uint8_t m_slot_count;
+    uint8_t m_free = NoSlot;
+    uint8_t m_used = 0;
+    bool (*m_schedule)(PromisePoolBase*, uint8_t);   // queue the task running the continuation of a slot
+
+    PromisePoolBase(Slot* slots, char* storage, uint16_t slot_size, uint8_t slot_count, bool (*schedule)(PromisePoolBase*, uint8_t)) :
+    m_slots(slots), m_storage(storage), m_slot_size(slot_size), m_slot_count(slot_count), m_schedule(schedule)
+    {}
+    PromisePoolBase(const PromisePoolBase&) = delete;
+
+    void init()
+    {
+        for(uint8_t i=m_slot_count; i>0; i--)
+        {
+            m_slots[i-1].flags = 0;
+            m_slots[i-1].generation = 0;
+            m_slots[i-1].count = m_free;
+            m_free = i-1;
+        }
+    }
+    void* bytes(uint8_t i) const { return m_storage + (std::size_t)i*m_slot_size; }
+    uint8_t acquire()
+    {
+        const uint8_t i = m_free;
+        if(i == NoSlot)
+            return NoSlot;
+        Slot& s = m_slots[i];
+        m_free = s.count;
+        s.run = nullptr;
+        s.destroy = nullptr;
+        s.flags = BUSY;
+        s.generation++;
+        s.count = 0;
+        m_used++;
+        return i;
+    }
+    void release(uint8_t i)
+    {
+        Slot& s = m_slots[i];
+        s.flags = 0;
+        s.count = m_free;
+        m_free = i;
+        m_used--;
+    }
+    void drop(uint8_t i)
+    {
+        Slot& s = m_slots[i];
+        if(s.destroy)
+            s.destroy(bytes(i), s.flags | DROPPED);
+        release(i);
+    }
+    // queue the continuation of a slot about to be settled and chained, before either is constructed,
+    // so a full loop leaves the slot as it was. the task runs in a later pass, after the caller has filled the slot
+    bool queue(uint8_t i)
+    {
+        if(!m_schedule(this, i))
+            return false;
+        m_slots[i].flags |= QUEUED;
+        return true;
+    }
+    // the body of the queued task
+    void runSlot(uint8_t i)
+    {
+        m_slots[i].run(bytes(i));
+        release(i);
+    }
+    template<typename T>
+    Promise<T> make();
+public:
+    uint8_t used() const { return m_used; }
+};
+
+template<typename T>
+class Promise
+{
+template<typename U> friend class Promise;
+friend class PromisePoolBase;
+template<class Loop, std::size_t slot_count, std::size_t slot_size> friend class PromisePool;
+private:
+    using Slot = PromisePoolBase::Slot;
+    PromisePoolBase* m_pool = nullptr;
+    uint8_t m_index = PromisePoolBase::NoSlot;
+    uint8_t m_generation = 0;
+
+    Promise(PromisePoolBase* pool, uint8_t index) : m_pool(pool), m_index(index), m_generation(pool->m_slots[index].generation) {}
+
+    Slot* slot() const
+    {
+        if(!m_pool)
+            return nullptr;
+        Slot* s = &m_pool->m_slots[m_index];
+        return (s->flags & PromisePoolBase::BUSY) && s->generation == m_generation ? s : nullptr;
+    }
+    void* bytes() const { return m_pool->bytes(m_index); }
+
+    static void destroyValue(void* bytes, uint8_t flags)
+    {
+        if(flags & PromisePoolBase::VALUE)
+            promise_impl::destroy<T>(bytes);
+    }
+    template<typename C>
+    static void destroyBoth(void* bytes, uint8_t flags)
+    {
+        if(flags & PromisePoolBase::DROPPED)
+            promise_impl::abandon(promise_impl::unbox<C>(static_cast<char*>(bytes) + promise_impl::continuationOffset<T>()), 0);
+        promise_impl::destroy<C>(static_cast<char*>(bytes) + promise_impl::continuationOffset<T>());
+        destroyValue(bytes, flags);
+    }
+    template<typename C>
+    static void invoke(void* bytes)
+    {
+        C& continuation = promise_impl::unbox<C>(static_cast<char*>(bytes) + promise_impl::continuationOffset<T>());
+        continuation(std::move(promise_impl::unbox<T>(bytes)));
+        destroyBoth<C>(bytes, PromisePoolBase::VALUE);
+    }
+
+    // attach the continuation, it is called with the value moved out of the slot
+    template<typename C>
+    bool attach(C&& continuation)
+    {
+        using Stored = typename std::remove_reference<C>::type;
+        Slot* s = slot();
+        if(!s || s->flags & PromisePoolBase::CHAINED
+           || promise_impl::continuationOffset<T>() + sizeof(promise_impl::Boxed<Stored>) > m_pool->m_slot_size)
+            return false;
+        if(s->flags & PromisePoolBase::SETTLED && !m_pool->queue(m_index))
+            return false;
+        new(static_cast<char*>(bytes()) + promise_impl::continuationOffset<T>()) promise_impl::Boxed<Stored>(std::forward<C>(continuation));
+        s->run = invoke<Stored>;
+        s->destroy = destroyBoth<Stored>;
+        s->flags |= PromisePoolBase::CHAINED;
+        return true;
+    }
+    // all(): the value is constructed up front and filled in piece by piece
+    template<std::size_t i, typename V>
+    void fill(V&& value)
+    {
+        Slot* s = slot();
+        if(!s)
+            return;
+        std::get<i>(promise_impl::unbox<T>(bytes())) = std::move(value);
+        if(--s->count)
+            return;
+        if(s->flags & PromisePoolBase::CHAINED && !m_pool->queue(m_index))
+            m_pool->drop(m_index);  // the loop is full, nothing would ever run the continuation
+        else
+            s->flags |= PromisePoolBase::SETTLED;
+    }
+
+    template<typename F, typename R>
+    struct Then
+    {
+        F func;
+        Promise<typename promise_impl::Settled<R>::type> next;
+        void operator()(T&& value) { settle(std::move(value), task_impl::Tag<promise_impl::Settled<R>::unwrap>()); }
+        void abandon() { next.drop(); }
+        void settle(T&& value, task_impl::Tag<false>) { call(std::move(value), task_impl::Tag<std::is_same<R, void>::value>()); }
+        void settle(T&& value, task_impl::Tag<true>)
+        {   // the next promise settles with the inner one, through one more continuation
+            R inner = func(std::move(value));
+            if(!inner.attach(typename R::Forward{next}))
+            {   // one chained already belongs to the caller, one the loop could not take is given back
+                Slot* s = inner.slot();
+                if(s && !(s->flags & PromisePoolBase::CHAINED))
+                    inner.drop();
+                next.drop();
+            }
+        }
+        // a resolve the loop cannot take ends the chain, its slots are given back
+        void call(T&& value, task_impl::Tag<false>)
+        {
+            if(!next.resolve(func(std::move(value))))
+                next.drop();
+        }
+        void call(T&& value, task_impl::Tag<true>)
+        {
+            func(std::move(value));
+            if(!next.resolve(PromiseVoid()))
+                next.drop();
+        }
+    };
+    struct Forward
+    {
+        Promise<T> next;
+        void operator()(T&& value)
+        {
+            if(!next.resolve(std::move(value)))
+                next.drop();
+        }
+        void abandon() { next.drop(); }
+    };
+public:
+    using value_type = T;
+
+    Promise() {}
+    // the handle still refers to a promise whose continuation has not run yet
+    explicit operator bool() const { return slot() != nullptr; }
+    bool settled() const { Slot* s = slot(); return s && s->flags & PromisePoolBase::SETTLED; }
+
+    // settle with the value, false if settled already, stale, or the loop could not take the task,
+    // then the promise is left as it was and the value untouched
+    template<typename V>
+    bool resolve(V&& value)
+    {
+        Slot* s = slot();
+        if(!s || s->flags & (PromisePoolBase::VALUE|PromisePoolBase::SETTLED))
+            return false;
+        if(s->flags & PromisePoolBase::CHAINED && !m_pool->queue(m_index))
+            return false;
+        new(bytes()) promise_impl::Boxed<T>(std::forward<V>(value));
+        if(!(s->flags & PromisePoolBase::CHAINED))
+            s->destroy = destroyValue;
+        s->flags |= PromisePoolBase::VALUE|PromisePoolBase::SETTLED;
+        return true;
+    }
+
+    // func(T&&) runs once the value is there, the promise returned settles with its result
+    template<typename F>
+    Promise<typename promise_impl::Settled<promise_impl::Result<F, T>>::type> then(F func)
+    {
+        using R = promise_impl::Result<F, T>;
+        using Next = Promise<typename promise_impl::Settled<R>::type>;
+        if(!slot())
+            return Next();
+        Next next = m_pool->template make<typename Next::value_type>();
+        if(!next)
+            return next;
+        if(!attach(Then<F, R>{std::move(func), next}))
+        {
+            next.drop();
+            return Next();
+        }
+        return next;
+    }
+
+    // give the slot back without running anything, false if stale or its continuation is queued already
+    bool drop()
+    {
+        Slot* s = slot();
+        if(!s || s->flags & PromisePoolBase::QUEUED)
+            return false;
+        m_pool->drop(m_index);
+        return true;
+    }
+};
+
+template<typename T>
+Promise<T> PromisePoolBase::make()
+{
+    if(sizeof(promise_impl::Boxed<T>) > m_slot_size)
+        return Promise<T>();
+    const uint8_t i = acquire();
+    return i == NoSlot ? Promise<T>() : Promise<T>(this, i);
+}
+
+/*
+    PromisePool: slot_count promises of the loop, a slot holds the value and the continuation of one promise,
+    both together at most slot_size bytes (the value padded to the alignment first).
+*/
+template<class Loop, std::size_t slot_count = 8, std::size_t slot_size = 6*sizeof(void*)>
+class PromisePool : public PromisePoolBase
+{
+static_assert(slot_count > 0 && slot_count < 0xFF, "PromisePool: slot_count must be in range [1, 254]");
+static_assert(slot_size < 0xFFFF, "PromisePool: slot_size is too large");
+private:
+    union alignas(TaskAlignment) Storage
+    {
+        char bytes[slot_size];
+    };
+    Loop& m_loop;
+    Slot m_headers[slot_count];
+    Storage m_storage[slot_count];
+
+    static void run(PromisePool* self, uint8_t i) { self->runSlot(i); }
+    static bool schedule(PromisePoolBase* base, uint8_t i)
+    {
+        PromisePool* self = static_cast<PromisePool*>(base);
+        return self->m_loop.nextTick(run, self, i);
+    }
+
+    template<typename Joined, typename ...Ts, std::size_t ...Is>
+    bool collect(Promise<Joined>& joined, std::index_sequence<Is...>, Promise<Ts>&... promises)
+    {
+        bool ok = true;
+        const bool attached[] = { (ok = ok && promises.attach(Collect<Joined, Is, Ts>{joined}))... };
+        (void)attached;
+        return ok;
+    }
+    template<typename Joined, std::size_t i, typename T>
+    struct Collect
+    {
+        Promise<Joined> joined;
+        void operator()(T&& value) { joined.template fill<i>(std::move(value)); }
+        void abandon() { joined.drop(); }   // all() can never settle without this one
+    };
+    template<typename T>
+    struct First
+    {
+        Promise<T> joined;
+        void operator()(T&& value)
+        {   // the first one settles it, a resolve the loop cannot take gives it back
+            if(!joined.resolve(std::move(value)) && !joined.settled())
+                joined.drop();
+        }
+    };
+public:
+    PromisePool(Loop& loop) :
+    PromisePoolBase(m_headers, m_storage[0].bytes, sizeof(Storage), slot_count, schedule),
+    m_loop(loop)
+    { init(); }
+    ~PromisePool()
+    {
+        for(uint8_t i=0; i<slot_count; i++)
+            if(m_headers[i].flags & BUSY)
+                drop(i);
+    }
+
+    static constexpr std::size_t SLOT_SIZE = sizeof(Storage);
+
+    // a promise nobody has resolved yet
+    template<typename T>
+    Promise<T> make()
+    {
+        static_assert(sizeof(promise_impl::Boxed<T>) <= slot_size, "PromisePool: the value is larger than a slot");
+        return PromisePoolBase::make<T>();
+    }
+    // a promise settled already, a continuation attached to it is queued at once
+    template<typename T>
+    Promise<typename std::remove_reference<T>::type> resolved(T&& value)
+    {
+        auto promise = make<typename std::remove_reference<T>::type>();
+        if(promise)
+            promise.resolve(std::forward<T>(value));
+        return promise;
+    }
+
+    // settles with every value once all of them have, the promises are consumed by it
+    template<typename ...Ts>
+    Promise<std::tuple<Ts...>> all(Promise<Ts>... promises)
+    {
+        using Joined = std::tuple<Ts...>;
+        static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 0xFF, "PromisePool: all() joins 1 to 254 promises");
+        Promise<Joined> joined = make<Joined>();
+        if(!joined)
+            return joined;
+        new(bytes(joined.m_index)) promise_impl::Boxed<Joined>();
+        Slot& s = m_headers[joined.m_index];
+        s.flags |= VALUE;
+        s.destroy = Promise<Joined>::destroyValue;
+        s.count = sizeof...(Ts);
+        if(!collect(joined, std::make_index_sequence<sizeof...(Ts)>(), promises...))
+        {   // the collectors attached so far find the handle stale
+            joined.drop();
+            return Promise<Joined>();
+        }
+        return joined;
+    }
+    // settles with the value of the first one to settle, the values of the others are dropped
+    template<typename T, typename ...More>
+    Promise<T> any(Promise<T> first, Promise<More>... more)
+    {
+        static_assert(AllSame<T, More...>::value, "PromisePool: any() joins promises of the same type");
+        Promise<T> joined = make<T>();
+        if(!joined)
+            return joined;
+        bool ok = first.attach(First<T>{joined});
+        const bool attached[] = { true, (ok = ok && more.attach(First<T>{joined}))... };
+        (void)attached;
+        if(!ok)
+        {
+            joined.drop();
+            return Promise<T>();
+        }
+        return joined;
+    }
+private:
+    template<typename T, typename ...More>
+    struct AllSame { static constexpr bool value = true; };
+    template<typename T, typename U, typename ...More>
+    struct AllSame<T, U, More...> { static constexpr bool value = std::is_same<T, U>::value && AllSame<T, More...>::value; };
+};
+
+#endif
@@ -5,7 +5,9 @@
     #include <type_traits>
     #include <tuple>
     #include <cstdint>
+    #include <cstddef>
     #include <cstdlib>
+    #include <cstring>
 #else
     #include "no_stdcpp_lib.h"
 #endif
@@ -20,15 +22,49 @@ enum class TaskType : uint8_t
     LONGTIMEOUT,
     EVENT,
     INTERVAL,
+    MICROTIMEOUT,
     DISABLED,
 };
 
+// the kinds a timeout may be stored as, found and cleared together
+inline bool isTimeout(TaskType type)
+{ return type == TaskType::TIMEOUT || type == TaskType::LONGTIMEOUT || type == TaskType::MICROTIMEOUT; }
+
+enum class TaskOp : uint8_t
+{
+    EXEC,
+    COPY,
+    DESTROY,
+    FADDR,
+};
+
+class TaskInterface;
+// the only code generated per task class: exec, copy, destroy and faddr in one function
+using TaskOpsFunc = void* (*)(TaskOp op, const TaskInterface* self, void* dst);
+
+// the alignment every task storage gives its tasks: the ring, the resident and injection slots, the promise slots
+#if defined(__AVR__)
+constexpr std::size_t TaskAlignment = 1;    // an 8bit core loads anything from any address
+#else
+constexpr std::size_t TaskAlignment = alignof(std::max_align_t);
+#endif
+
+/*
+    TaskInterface: the header of every task, no vtable.
+    The type tag, size and the timing fields of the bases are read in place, so the loop never makes an indirect call
+    to look at a task, only exec(), copy(), destroy() and faddr() go through the single ops function of the task class.
+*/
 class TaskInterface
 {
-public:
-    TaskInterface() {};
-    virtual ~TaskInterface() {};
+protected:
+    TaskOpsFunc m_ops = nullptr;
+    TaskType m_type;
+    uint16_t m_size : 15;
+    uint16_t m_trivial : 1;     // plain bytes, copied by memcpy and never destructed, without calling m_ops
 
+    TaskInterface(TaskType type) : m_type(type), m_size(0), m_trivial(1) {}
+    ~TaskInterface() = default;     // use destroy(), the header does not know the task class
+public:
     // for normal function
     template<typename Ret, typename ...Args>
     static constexpr void* extract_raw_function_pointer(Ret func(Args...))
@@ -49,35 +85,55 @@ public:
         return (void* &)funcptr;
     }
     // return the size of this task
-    virtual std::size_t size() const = 0;
+    std::size_t size() const { return m_size; }
     // return the task type
-    virtual TaskType type() const = 0;
+    TaskType type() const { return m_type; }
     // execute this task with the arguments inside
-    virtual void exec() {};
+    void exec() { if(m_ops) m_ops(TaskOp::EXEC, this, nullptr); }
     // return the function pointer of the task
-    virtual void* faddr() const { return nullptr; }
+    void* faddr() const { return m_ops ? m_ops(TaskOp::FADDR, this, nullptr) : nullptr; }
     // copy this task to the specified destination
-    virtual void copy(void* dst) const { };
+    void copy(void* dst) const
+    {
+        if(m_trivial)
+            memcpy(dst, this, m_size);
+        else
+            m_ops(TaskOp::COPY, this, dst);
+    }
+    // destruct this task in place, the storage is left to the owner
+    void destroy() { if(!m_trivial) m_ops(TaskOp::DESTROY, this, nullptr); }
     
     // TimeoutTask<> || IntervalTask<>: get the remaining time of the task
-    virtual uint16_t getTimeLeft() const { return 0; }
+    uint16_t getTimeLeft() const;
     // TimeoutTask<> || IntervalTask<>: set the remaining time of the task
-    virtual void setTimeLeft(uint16_t ms) { }
+    void setTimeLeft(uint16_t ms);
 
     // LongTimeoutTask<>: get the schedule time of the task
-    virtual Time getScheduleTime() const { return 0; }
+    Time getScheduleTime() const;
     // LongTimeoutTask<>: set the schedule time of the task
-    virtual void setScheduleTime(const Time& time) { }
+    void setScheduleTime(const Time& time);
+
+    // MicroTimeoutTask<>: get the Time::micros() the task is due at
+    uint32_t getDeadlineUs() const;
+    // MicroTimeoutTask<>: set the Time::micros() the task is due at
+    void setDeadlineUs(uint32_t us);
 
-    // EventTask<>: update keeper of the task
-    virtual void updateKeeper() { }
-    // EventTask<>: set the keeper of the task
-    virtual void setKeeper(TaskInterface** keeper) { }
+    // EventTask<> || TimeoutTask<> || LongTimeoutTask<> || IntervalTask<>: update keeper of the task
+    void updateKeeper();
+    // EventTask<> || TimeoutTask<> || LongTimeoutTask<> || IntervalTask<>: set the keeper of the task
+    void setKeeper(TaskInterface** keeper);
+
+    // EventTask<>: an exec() of it is in progress, it is only marked cleared then, see EventLoop::disableTask()
+    bool isFiring() const;
+    // EventTask<>: cleared while firing, the loop destroys it in its next pass
+    bool isCleared() const;
+    // EventTask<>: mark it cleared
+    void setCleared();
 
     // IntervalTask<>: get interval time
-    virtual uint16_t getInterval() const { return 0; }
+    uint16_t getInterval() const;
     // IntervalTask<>: set interval time
-    virtual void setInterval(uint16_t interval) { }
+    void setInterval(uint16_t interval);
 
     // in place new, stdc++ library for avr8 does not provide any new/delete opearator
     void* operator new(std::size_t size, void *ptr)
@@ -90,20 +146,21 @@ public:
     }
 };
 
+// what is left of a task disabled in the queue, only its size matters
 class DisabledTask : public TaskInterface
 {
-private:
-    std::size_t m_size;
 public:
-    DisabledTask(std::size_t org_size) : m_size(org_size) {}
-
-    std::size_t size() const final { return m_size; }
-    TaskType type() const final { return TaskType::DISABLED; }
+    DisabledTask(std::size_t org_size) : TaskInterface(TaskType::DISABLED) { m_size = org_size; }
 };
 
 namespace task_impl
 {
 
+template<bool> struct Tag {};
+class EventTaskBase;
+// selects the constructor that forwards the arguments right into the task, see EventLoop::emplaceTick()
+struct EmplaceTag {};
+
 template<template<class> class Derived, typename Callable, typename Base>
 class TaskMixin : public Base
 {
@@ -121,22 +178,57 @@ private:
                                 >::type;    
     Arguments m_args;
     StoreType m_func;
+
+    static void* ops(TaskOp op, const TaskInterface* self, void* dst)
+    {
+        auto task = static_cast<const TaskMixin*>(self);
+        switch(op)
+        {
+        case TaskOp::EXEC:
+            const_cast<TaskMixin*>(task)->exec(Tag<std::is_same<Base, EventTaskBase>::value>());
+            break;
+        case TaskOp::COPY:
+            task->copyTo(dst, Tag<std::is_copy_constructible<Derived<Callable>>::value>());
+            break;
+        case TaskOp::DESTROY:
+            static_cast<const Derived<Callable>*>(task)->~Derived<Callable>();
+            break;
+        case TaskOp::FADDR:
+            return TaskInterface::extract_raw_function_pointer(task->m_func);
+        }
+        return nullptr;
+    }
+    // an event task is fired from anywhere, even from inside itself, it is marked around the call to be destroyed safely
+    void exec(Tag<true>) { this->enter(); run(Tag<Base::one_shot>()); this->leave(); }
+    void exec(Tag<false>) { run(Tag<Base::one_shot>()); }
+    // a task running only once hands its arguments over to the call, so they can be move-only
+    void run(Tag<true>) { std::apply(m_func, std::move(m_args)); }
+    void run(Tag<false>) { std::apply(m_func, m_args); }
+    // a move-only task is moved instead, the loop always destroys the source right after copying a task
+    void copyTo(void* dst, Tag<true>) const
+    { new(dst) Derived<Callable>(*static_cast<const Derived<Callable>*>(this)); }
+    void copyTo(void* dst, Tag<false>) const
+    { new(dst) Derived<Callable>(std::move(*static_cast<Derived<Callable>*>(const_cast<TaskMixin*>(this)))); }
+    void init()
+    {
+        static_assert(alignof(Derived<Callable>) <= TaskAlignment, "Task: the callable or an argument is over aligned, no task storage can hold it");
+        this->m_ops = &ops;
+        this->m_size = sizeof(Derived<Callable>);
+        this->m_trivial = std::is_trivially_copyable<Derived<Callable>>::value;
+    }
 public:
     // default empty constructor gets error when using lambda
-    TaskMixin() {}
+    TaskMixin() { init(); }
     TaskMixin(Callable func) : m_func(func)
-    {}
-    TaskMixin(Callable func, Arguments args) : m_func(func), m_args(args)
-    {}
-    ~TaskMixin() {}
+    { init(); }
+    TaskMixin(Callable func, Arguments args) : m_args(args), m_func(func)
+    { init(); }
+    template<typename ...Args>
+    TaskMixin(EmplaceTag, Callable func, Args&&... args) : m_args(std::forward<Args>(args)...), m_func(std::move(func))
+    { init(); }
 
     Derived<Callable>& setFunc(Callable func) { m_func = func; return *static_cast<Derived<Callable>*>(this); }
     Derived<Callable>& setArgs(Arguments args) { m_args = args; return *static_cast<Derived<Callable>*>(this); }
-    void exec() final { std::apply(m_func, m_args); }
-    
-    std::size_t size() const final { return sizeof(Derived<Callable>); }
-    void* faddr() const final { return TaskInterface::extract_raw_function_pointer(m_func); }
-    void copy(void *dst) const final { new(dst) Derived<Callable>(*static_cast<const Derived<Callable>*>(this)); }
 
     template<template<class> class Similar>
     constexpr Similar<Callable> transform() const
@@ -148,54 +240,173 @@ public:
 class DefaultTaskBase : public TaskInterface
 {
 public:
-    TaskType type() const final { return TaskType::DEFAULT_TASK; }
+    static constexpr bool one_shot = true;
+    DefaultTaskBase() : TaskInterface(TaskType::DEFAULT_TASK) {}
+};
+
+// a task referred from outside by a keeper pointer, the keeper follows the task when it moves in the queue,
+// and is reset when the task that it points to is destroyed
+class KeptTaskBase : public TaskInterface
+{
+private:
+    TaskInterface** m_keeper = nullptr;
+protected:
+    KeptTaskBase(TaskType type) : TaskInterface(type) {}
+public:
+    ~KeptTaskBase() { if(m_keeper && *m_keeper == this) *m_keeper = nullptr; }
+    void updateKeeper() { if(m_keeper) *m_keeper = this; }
+    void setKeeper(TaskInterface** keeper) { m_keeper = keeper; }
 };
 
-class TimeoutTaskBase : public TaskInterface
+class TimeoutTaskBase : public KeptTaskBase
 {
 private:
     uint16_t m_time = 0;
 public:
-    TaskType type() const final { return TaskType::TIMEOUT; }
-    uint16_t getTimeLeft() const final { return m_time; }
-    void setTimeLeft(uint16_t ms) final { m_time = ms; }
+    static constexpr bool one_shot = true;
+    TimeoutTaskBase() : KeptTaskBase(TaskType::TIMEOUT) {}
+    uint16_t getTimeLeft() const { return m_time; }
+    void setTimeLeft(uint16_t ms) { m_time = ms; }
 };
 
-class LongTimeoutTaskBase : public TaskInterface
+class LongTimeoutTaskBase : public KeptTaskBase
 {
 private:
     Time m_schedule = 0;
 public:
-    TaskType type() const final { return TaskType::LONGTIMEOUT; }
-    Time getScheduleTime() const final { return m_schedule; }
-    void setScheduleTime(const Time& time) final { m_schedule = time; }
+    static constexpr bool one_shot = true;
+    LongTimeoutTaskBase() : KeptTaskBase(TaskType::LONGTIMEOUT) {}
+    Time getScheduleTime() const { return m_schedule; }
+    void setScheduleTime(const Time& time) { m_schedule = time; }
 };
 
-class EventTaskBase : public TaskInterface
+class MicroTimeoutTaskBase : public KeptTaskBase
 {
 private:
-    TaskInterface** m_keeper = nullptr;
+    uint32_t m_deadline = 0;
 public:
-    TaskType type() const final { return TaskType::EVENT; }
-    void updateKeeper() final { if(m_keeper) *m_keeper = this; }
-    void setKeeper(TaskInterface** keeper) final { m_keeper = keeper; }
+    static constexpr bool one_shot = true;
+    MicroTimeoutTaskBase() : KeptTaskBase(TaskType::MICROTIMEOUT) {}
+    uint32_t getDeadlineUs() const { return m_deadline; }
+    void setDeadlineUs(uint32_t us) { m_deadline = us; }
 };
 
-class IntervalTaskBase : public TaskInterface
+class EventTaskBase : public KeptTaskBase
+{
+private:
+    uint8_t m_firing = 0;       // exec() calls in progress, an ISR may fire it again while it runs
+    bool m_cleared = false;
+public:
+    static constexpr bool one_shot = false;
+    EventTaskBase() : KeptTaskBase(TaskType::EVENT) {}
+    void enter() { m_firing++; }
+    void leave() { m_firing--; }
+    bool isFiring() const { return m_firing; }
+    bool isCleared() const { return m_cleared; }
+    void setCleared() { m_cleared = true; }
+};
+
+class IntervalTaskBase : public KeptTaskBase
 {
 private:
     uint16_t m_interval = 0;
     uint16_t m_time = 0;
 public:
-    TaskType type() const final { return TaskType::INTERVAL; }
-    uint16_t getInterval() const final { return m_interval; }
-    void setInterval(uint16_t ms) final { m_interval = ms; }
-    uint16_t getTimeLeft() const final { return m_time; }
-    void setTimeLeft(uint16_t ms) final { m_time = ms; }
+    static constexpr bool one_shot = false;
+    IntervalTaskBase() : KeptTaskBase(TaskType::INTERVAL) {}
+    uint16_t getInterval() const { return m_interval; }
+    void setInterval(uint16_t ms) { m_interval = ms; }
+    uint16_t getTimeLeft() const { return m_time; }
+    void setTimeLeft(uint16_t ms) { m_time = ms; }
 };
 
 };
 
+// the accessors of the header pick the base by the type tag, a task of another type ignores them
+inline uint16_t TaskInterface::getTimeLeft() const
+{
+    if(m_type == TaskType::TIMEOUT)
+        return static_cast<const task_impl::TimeoutTaskBase*>(this)->getTimeLeft();
+    if(m_type == TaskType::INTERVAL)
+        return static_cast<const task_impl::IntervalTaskBase*>(this)->getTimeLeft();
+    return 0;
+}
+
+inline void TaskInterface::setTimeLeft(uint16_t ms)
+{
+    if(m_type == TaskType::TIMEOUT)
+        static_cast<task_impl::TimeoutTaskBase*>(this)->setTimeLeft(ms);
+    else if(m_type == TaskType::INTERVAL)
+        static_cast<task_impl::IntervalTaskBase*>(this)->setTimeLeft(ms);
+}
+
+inline Time TaskInterface::getScheduleTime() const
+{
+    if(m_type == TaskType::LONGTIMEOUT)
+        return static_cast<const task_impl::LongTimeoutTaskBase*>(this)->getScheduleTime();
+    return 0;
+}
+
+inline void TaskInterface::setScheduleTime(const Time& time)
+{
+    if(m_type == TaskType::LONGTIMEOUT)
+        static_cast<task_impl::LongTimeoutTaskBase*>(this)->setScheduleTime(time);
+}
+
+inline uint32_t TaskInterface::getDeadlineUs() const
+{
+    if(m_type == TaskType::MICROTIMEOUT)
+        return static_cast<const task_impl::MicroTimeoutTaskBase*>(this)->getDeadlineUs();
+    return 0;
+}
+
+inline void TaskInterface::setDeadlineUs(uint32_t us)
+{
+    if(m_type == TaskType::MICROTIMEOUT)
+        static_cast<task_impl::MicroTimeoutTaskBase*>(this)->setDeadlineUs(us);
+}
+
+inline void TaskInterface::updateKeeper()
+{
+    if(m_type != TaskType::DEFAULT_TASK && m_type != TaskType::DISABLED)
+        static_cast<task_impl::KeptTaskBase*>(this)->updateKeeper();
+}
+
+inline void TaskInterface::setKeeper(TaskInterface** keeper)
+{
+    if(m_type != TaskType::DEFAULT_TASK && m_type != TaskType::DISABLED)
+        static_cast<task_impl::KeptTaskBase*>(this)->setKeeper(keeper);
+}
+
+inline bool TaskInterface::isFiring() const
+{
+    return m_type == TaskType::EVENT && static_cast<const task_impl::EventTaskBase*>(this)->isFiring();
+}
+
+inline bool TaskInterface::isCleared() const
+{
+    return m_type == TaskType::EVENT && static_cast<const task_impl::EventTaskBase*>(this)->isCleared();
+}
+
+inline void TaskInterface::setCleared()
+{
+    if(m_type == TaskType::EVENT)
+        static_cast<task_impl::EventTaskBase*>(this)->setCleared();
+}
+
+inline uint16_t TaskInterface::getInterval() const
+{
+    if(m_type == TaskType::INTERVAL)
+        return static_cast<const task_impl::IntervalTaskBase*>(this)->getInterval();
+    return 0;
+}
+
+inline void TaskInterface::setInterval(uint16_t ms)
+{
+    if(m_type == TaskType::INTERVAL)
+        static_cast<task_impl::IntervalTaskBase*>(this)->setInterval(ms);
+}
+
 template<typename Callable>
 class Task : public task_impl::TaskMixin<Task, Callable, task_impl::DefaultTaskBase>
 {
@@ -218,6 +429,13 @@ public:
     using task_impl::TaskMixin<LongTimeoutTask, Callable, task_impl::LongTimeoutTaskBase>::TaskMixin;
 };
 
+template<typename Callable>
+class MicroTimeoutTask : public task_impl::TaskMixin<MicroTimeoutTask, Callable, task_impl::MicroTimeoutTaskBase>
+{
+public:
+    using task_impl::TaskMixin<MicroTimeoutTask, Callable, task_impl::MicroTimeoutTaskBase>::TaskMixin;
+};
+
 template<typename Callable>
 class EventTask : public task_impl::TaskMixin<EventTask, Callable, task_impl::EventTaskBase>
 {
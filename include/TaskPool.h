@@ -0,0 +1,125 @@
+#ifndef __TASKPOOL_H__
+    #define __TASKPOOL_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "Task.h"
+
+using SlotIndex = uint8_t;
+constexpr SlotIndex NoSlot = 0xFF;
+
+/*
+    TaskPool: a fixed number of fixed size slots, each one holds a task constructed in place.
+    Unlike CircularTaskQueue, slots can be released in any order, so a task never moves until it is destroyed.
+    Tasks larger than slot_size cannot be stored here. slot_count can be 0, then every construct() fails.
+*/
+template<std::size_t slot_count, std::size_t slot_size>
+class TaskPool
+{
+static_assert(slot_count < NoSlot, "TaskPool: slot_count must be less than 255");
+static_assert(slot_size >= sizeof(TaskInterface), "TaskPool: slot_size is too small to hold any task");
+private:
+    union alignas(TaskAlignment) Slot
+    {
+        char bytes[slot_size];
+        SlotIndex next_free;
+    };
+    static constexpr std::size_t storage_count = slot_count ? slot_count : 1;
+
+    Slot m_slots[storage_count];
+    uint8_t m_busy[(storage_count+7)/8] = {0};
+    SlotIndex m_free = NoSlot;  // head of the free list, the next index is stored inside the free slot
+    uint8_t m_used = 0;
+
+    void setBusy(SlotIndex i, bool busy)
+    {
+        if(busy)
+            m_busy[i>>3] |= (1<<(i&7));
+        else
+            m_busy[i>>3] &= ~(1<<(i&7));
+    }
+    // pop a slot off the free list, there must be one
+    SlotIndex take()
+    {
+        const SlotIndex i = m_free;
+        m_free = m_slots[i].next_free;
+        setBusy(i, true);
+        m_used++;
+        return i;
+    }
+public:
+    static constexpr std::size_t SLOT_COUNT = slot_count;
+    static constexpr std::size_t SLOT_SIZE = slot_size;
+
+    TaskPool()
+    {
+        for(SlotIndex i=slot_count; i>0; i--)
+        {
+            m_slots[i-1].next_free = m_free;
+            m_free = i-1;
+        }
+    }
+    TaskPool(const TaskPool&) = delete;
+    ~TaskPool()
+    {
+        for(SlotIndex i=0; i<slot_count; i++)
+            if(isBusy(i))
+                destroy(i);
+    }
+
+    uint8_t used() const { return m_used; }
+    bool full() const { return m_free == NoSlot; }
+    static constexpr bool fits(std::size_t size) { return slot_count > 0 && size <= slot_size; }
+    bool isBusy(SlotIndex i) const { return m_busy[i>>3] & (1<<(i&7)); }
+
+    TaskInterface* at(SlotIndex i) { return reinterpret_cast<TaskInterface*>(m_slots[i].bytes); }
+    bool contains(const TaskInterface* ptr) const
+    {
+        auto p = reinterpret_cast<const Slot*>(ptr);
+        return slot_count > 0 && p >= m_slots && p < m_slots + slot_count;
+    }
+    SlotIndex indexOf(const TaskInterface* ptr) const
+    { return reinterpret_cast<const Slot*>(ptr) - m_slots; }
+
+    SlotIndex construct(const TaskInterface* ptr);
+    // construct a T right in a free slot, NoSlot if there is no place for it
+    template<typename T, typename ...CtorArgs>
+    SlotIndex emplace(CtorArgs&&... args)
+    {
+        if(m_free == NoSlot || !fits(sizeof(T)))
+            return NoSlot;
+        const SlotIndex i = take();
+        new(m_slots[i].bytes) T(std::forward<CtorArgs>(args)...);
+        return i;
+    }
+    void destroy(SlotIndex i);
+};
+
+// copy the task into a free slot, return NoSlot if there is no place for it
+template<std::size_t slot_count, std::size_t slot_size>
+SlotIndex TaskPool<slot_count, slot_size>::construct(const TaskInterface* ptr)
+{
+    if(m_free == NoSlot || !fits(ptr->size()))
+        return NoSlot;
+    const SlotIndex i = take();
+    ptr->copy(m_slots[i].bytes);
+    return i;
+}
+
+// destroy the task in the slot and give the slot back to the free list
+template<std::size_t slot_count, std::size_t slot_size>
+void TaskPool<slot_count, slot_size>::destroy(SlotIndex i)
+{
+    at(i)->destroy();   // NOT using delete here since we constructed it IN PLACE!
+    setBusy(i, false);
+    m_slots[i].next_free = m_free;
+    m_free = i;
+    m_used--;
+}
+
+#endif
@@ -8,11 +8,62 @@
     #include "no_stdcpp_lib.h"
 #endif
 
-#include <util/atomic.h>
+#include "Platform.h"
 #include "compile_time.h"
+
+#ifdef PLATFORM_POSIX
+    #include <atomic>
+#endif
+
+/*
+    ShortTime: the low 32 bits of the absolute time, for measuring from one point to another without 64bit math on avr.
+    It wraps every ~49.7 days, so only the difference of two of them (a TimeDelta) means anything,
+    and it is right as long as they are less than ~24.8 days apart, e.g. the time passed between two passes of the loop.
+*/
+typedef int32_t TimeDelta;
+
+class ShortTime
+{
+private:
+    uint32_t m_ms;
+public:
+    ShortTime() : m_ms(0) {}
+    explicit ShortTime(uint32_t ms) : m_ms(ms) {}
+
+    uint32_t ms() const { return m_ms; }
+    TimeDelta operator-(ShortTime rhs) const { return (TimeDelta)(m_ms - rhs.m_ms); }
+    ShortTime operator+(TimeDelta delta) const { return ShortTime(m_ms + (uint32_t)delta); }
+    bool operator==(ShortTime rhs) const { return m_ms == rhs.m_ms; }
+    bool operator!=(ShortTime rhs) const { return m_ms != rhs.m_ms; }
+    bool operator<(ShortTime rhs) const { return *this - rhs < 0; }
+    bool operator<=(ShortTime rhs) const { return *this - rhs <= 0; }
+    bool operator>(ShortTime rhs) const { return *this - rhs > 0; }
+    bool operator>=(ShortTime rhs) const { return *this - rhs >= 0; }
+};
+
+/*
+    TickCounter: the live counter of the hardware timer whose ISR calls Time::tick(), given to Time::setTickCounter()
+    so the time is read between two ticks as well. The tick ISR can then run at e.g. 100Hz calling tick(10),
+    absolute() still moves in single ms and micros() in single us.
+    count() runs from 0 up to top-1 and wraps when the tick interrupt is raised, pending() is its interrupt flag:
+    raised but not served yet, because interrupts are off or the read itself runs in another ISR. e.g. for timer1 in CTC
+        { []{ return (uint16_t)TCNT1; }, []{ return (bool)(TIFR1 & (1<<OCF1A)); }, OCR1A+1, 10000 }
+    tick_us must be a whole number of ms below 32768 us, what the ISR passes to tick() times 1000.
+*/
+struct TickCounter
+{
+    uint16_t (*count)();
+    bool (*pending)();
+    uint16_t top;       // counts per tick
+    uint16_t tick_us;   // us per tick
+};
+
 /*  
     Time Singleton: Provide the type to represent time, 
     and holds the current time from booted up and offset to the real time
+    The singleton is read without masking interrupts: tick() makes a sequence number odd while it writes,
+    a read that saw it odd or saw it change is done again. On avr the ISR always runs to its end before the read
+    goes on, so a read is retried at most once per tick and the timer ISR is never held back by a reader.
 */
 class Time
 {
@@ -22,39 +73,121 @@ private:
 
     static int64_t s_offset;    // offset to the real time in ms
     static Time& getInstance() { static Time self(0); return self; }   // need -fno-threadsafe-statics flag to compile, we dont need thread-safe in avr anyway
+    static uint8_t& sequence() { static uint8_t self = 0; return self; }  // odd while tick() writes
+
+    struct TickSource
+    {
+        const TickCounter* counter = nullptr;
+        uint32_t us_scale = 0;  // us per count, 16.16 fixed point, so a read needs no division
+        uint8_t tick_ms = 1;
+    };
+    static TickSource& tickSource() { static TickSource self; return self; }
+
+    // a consistent copy of the singleton fields, the kernel's seqlock: volatile fields between fenced sequence loads.
+    // returns the us passed since the fields were last ticked, 0 without a TickCounter
+    static uint16_t read(uint32_t& high, uint16_t& low)
+    {
+        const volatile Time& self = getInstance();
+        const TickSource& source = tickSource();
+        uint8_t seq;
+        uint32_t counts;
+        do {
+            seq = __atomic_load_n(&sequence(), __ATOMIC_ACQUIRE);
+            high = self.m_1;
+            low = self.m_2;
+            counts = 0;
+            if(source.counter)
+            {   // a small count with the flag raised wrapped after the fields were ticked last, it is one tick on
+                counts = source.counter->count();
+                if(source.counter->pending() && counts < source.counter->top/2u)
+                    counts += source.counter->top;
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while((seq & 1) || seq != __atomic_load_n(&sequence(), __ATOMIC_RELAXED));
+        return (counts*source.us_scale) >> 16;
+    }
+
+    // the write side, also() runs inside it for what has to change together with the time
+    template<typename Also>
+    static void write(int16_t ms, Also also)
+    {
+        CriticalSection guard;
+        volatile Time& self = getInstance();
+        const uint8_t seq = __atomic_load_n(&sequence(), __ATOMIC_RELAXED);
+        __atomic_store_n(&sequence(), seq+1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        const int32_t low = (int32_t)self.m_2 + ms;     // the carry is -1, 0 or 1, no 48bit math in the ISR
+        self.m_1 = self.m_1 + (uint32_t)(low>>16);
+        self.m_2 = low&0xFFFF;
+        also();
+        __atomic_store_n(&sequence(), seq+2, __ATOMIC_RELEASE);
+    }
+    static void nothing() {}
+
+    friend class SimulatedTickTimer;
 public:
     Time() : m_1(0), m_2(0) {}
     Time(uint64_t t) : m_1(t>>16), m_2(t&0xFFFF) {}
     
     operator uint64_t() const { return ((uint64_t)m_1<<16) + m_2; }
 
+    // on a host the monotonic clock runs on its own, tick() can still push the time forward on top of it
     static Time absolute() 
     { 
         Time temp;
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { temp = getInstance(); } 
-        return temp; 
+        const uint16_t us = read(temp.m_1, temp.m_2);
+        return temp + platformMillis() + us/1000u; 
     }
+    // only the low 32 bits, for the loop measuring the time between its passes
+    static ShortTime absoluteShort()
+    {
+        uint32_t high;
+        uint16_t low;
+        const uint16_t us = read(high, low);
+        return ShortTime((high<<16) + low + (uint32_t)platformMillis() + us/1000u);
+    }
+    // us since boot, wraps every ~71.6 minutes so compare as (int32_t)(a-b). without a TickCounter it moves by
+    // whole ticks on avr, on a host it comes from the monotonic clock
+    static uint32_t micros()
+    {
+        uint32_t high;
+        uint16_t low;
+        const uint16_t us = read(high, low);
+        return ((high<<16) + low)*1000 + us + (uint32_t)platformMicros();
+    }
+    // read the counter of the tick timer from now on, nullptr to stop. set it up before the tick ISR is enabled
+    static void setTickCounter(const TickCounter* counter)
+    {
+        TickSource& source = tickSource();
+        CriticalSection guard;
+        source.counter = counter;
+        source.us_scale = counter ? ((uint32_t)counter->tick_us<<16)/counter->top : 0;
+        source.tick_ms = counter && counter->tick_us >= 1000 ? counter->tick_us/1000 : 1;
+    }
+    // ms between two tick ISRs, an idle loop sleeping until the next interrupt may oversleep a deadline by that much
+    static uint8_t tickMillis() { return tickSource().tick_ms; }
     static Time now() { return absolute() + s_offset; }
     static int64_t getOffset() { return s_offset; }
     static void setOffset(int64_t offset) { s_offset = offset; }
 
     // note: the absolute time cannot be modified except by timer ISR, 
     // and the timer ISR should only increase the absolute time by tick()
-    static void tick(int16_t ms=1) { getInstance() = getInstance() + ms; }
+    // the guard only keeps writers apart (costs nothing inside the ISR), readers go by the sequence number
+    static void tick(int16_t ms=1) { write(ms, nothing); }
     
     // from unix timestamp to civil date. reference: http://howardhinnant.github.io/date_algorithms.html
-    
+    // each of these starts over with 64bit divisions, CivilTime breaks a Time down once for reading many fields
     std::tuple<uint16_t, uint8_t, uint8_t> getDate()
     {
         const uint64_t days = *this/1000/60/60/24 + 719468;   // days since 0000-03-01
         const uint8_t eras = days/146097;                     // eras since 0000-03-01
         const uint32_t day_of_eras = days%146097;             // nth day of this era [0, 146096]
         const uint16_t year_of_eras = (day_of_eras - day_of_eras/1460 + day_of_eras/36524 - day_of_eras/146096)/365; // nth year of this era [0, 399]
-        const uint16_t year = year_of_eras + 400*eras;        // current year
         const uint16_t day_of_year = day_of_eras - (365*year_of_eras + year_of_eras/4 - year_of_eras/100); // nth day of this year [0, 365]
         const uint8_t month_p = (5*day_of_year + 2)/153;        // [0, 11]
         const uint8_t day = day_of_year - (153*month_p + 2)/5 + 1; // nth day of this month [1, 31]
         const uint8_t month = month_p + (month_p>9 ? -9 : 3); // current month [1, 12]
+        const uint16_t year = year_of_eras + 400*eras + (month <= 2); // current year, january and february end the year begun in march
         return std::make_tuple(year, month, day);
     }
 
@@ -70,7 +203,11 @@ public:
         const uint32_t day_of_eras = days%146097;             // nth day of this era [0, 146096]
         const uint16_t year_of_eras = (day_of_eras - day_of_eras/1460 + day_of_eras/36524 - day_of_eras/146096)/365; // nth year of this era [0, 399]
         const uint16_t day_of_year = day_of_eras - (365*year_of_eras + year_of_eras/4 - year_of_eras/100); // nth day of this year [0, 365]
-        return day_of_year/7 + 1;
+        if(day_of_year >= 306)  // january and february
+            return (day_of_year-306)/7 + 1;
+        const uint16_t year = year_of_eras + 400*(days/146097);
+        const bool leap = year%4 == 0 && (year%100 != 0 || year%400 == 0);
+        return (day_of_year + 59 + leap)/7 + 1;         // weeks count from january 1st
     }
 
     uint8_t getHours()
@@ -90,4 +227,59 @@ public:
 
 };
 
+#ifdef PLATFORM_POSIX
+/*
+    SimulatedTickTimer: the hardware timer of a TickCounter on a host, for testing what reads the time against the
+    overflow race. Nothing runs on its own: advance() is the hardware counting on, which raises the interrupt flag
+    when the counter wraps, serve() is the tick ISR. A read between the two sees a wrapped counter with the time not
+    ticked yet, as a read with interrupts off does on avr. One timer at a time, it is the TickCounter of Time while it lives.
+*/
+class SimulatedTickTimer
+{
+private:
+    std::atomic<uint16_t> m_count{0};
+    std::atomic<bool> m_pending{false};
+    const TickCounter m_counter;
+
+    static SimulatedTickTimer*& current() { static SimulatedTickTimer* self = nullptr; return self; }
+    static uint16_t count() { return current()->m_count.load(); }
+    static bool pending() { return current()->m_pending.load(); }
+public:
+    SimulatedTickTimer(uint16_t top, uint16_t tick_us) : m_counter{count, pending, top, tick_us}
+    {
+        current() = this;
+        Time::setTickCounter(&m_counter);
+    }
+    ~SimulatedTickTimer()
+    {
+        Time::setTickCounter(nullptr);
+        current() = nullptr;
+    }
+    SimulatedTickTimer(const SimulatedTickTimer&) = delete;
+
+    // count on by less than top/2, false if it wrapped with the flag still raised: the tick before was never served
+    bool advance(uint16_t counts)
+    {
+        uint32_t next = m_count.load() + counts;
+        bool lost = false;
+        if(next >= m_counter.top)
+        {   // the flag goes up first, whoever reads the wrapped count sees it
+            lost = m_pending.exchange(true);
+            next -= m_counter.top;
+        }
+        m_count.store(next);
+        return !lost;
+    }
+    // the ISR, clears the flag in the same write as the tick. false if there was nothing to serve
+    bool serve()
+    {
+        if(!m_pending.load())
+            return false;
+        Time::write(m_counter.tick_us/1000, [this](){ m_pending.store(false); });
+        return true;
+    }
+    uint16_t counts() const { return m_count.load(); }
+};
+#endif
+
 #endif
\ No newline at end of file
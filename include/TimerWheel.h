@@ -0,0 +1,278 @@
+#ifndef __TIMERWHEEL_H__
+    #define __TIMERWHEEL_H__
+
+#ifdef USE_STDCPP_LIB
+    #include <cstdint>
+    #include <cstddef>
+#else
+    #include "no_stdcpp_lib.h"
+#endif
+
+#include "TaskPool.h"
+
+constexpr uint32_t NoDeadline = 0xFFFFFFFF;
+
+/*
+    TimerWheel: a hierarchical timer wheel indexing the slots of a TaskPool by their deadline.
+    Level n has WHEEL_SIZE buckets, each one covers WHEEL_SIZE^n ms, so the wheel spans WHEEL_SIZE^WHEEL_LEVELS ms,
+    timers further than that wait in the overflow list. advance() only visits the buckets whose time has come,
+    the timers inside either expire or cascade down to a finer level, so each timer is touched at most
+    WHEEL_LEVELS times before it expires, no matter how many loop iterations it waits.
+    The wheel never touches the tasks, it only keeps deadlines and links by slot index.
+    A timer may have slack: it still expires at its deadline, but nextExpiry() counts it only at the latest point it
+    can wait until, rounded down to a multiple of 2^n ms of the wheel time (2^n <= slack+1). An idle loop then sleeps
+    past it, the timer fires in whatever pass comes first, and lax timers with overlapping windows share a boundary.
+*/
+template<std::size_t slot_count>
+class TimerWheel
+{
+public:
+    static constexpr uint8_t WHEEL_BITS = 3;
+    static constexpr uint8_t WHEEL_SIZE = 1<<WHEEL_BITS;
+    static constexpr uint8_t WHEEL_LEVELS = 5;
+    static constexpr uint32_t WHEEL_SPAN = (uint32_t)1<<(WHEEL_BITS*WHEEL_LEVELS);  // 32768ms
+    static constexpr uint32_t MAX_DELAY = 0x7FFFFFFF;   // deadlines are compared in wrapping 32bit arithmetic
+private:
+    static constexpr uint8_t WHEEL_MASK = WHEEL_SIZE-1;
+    static constexpr uint8_t OVERFLOW_LIST = WHEEL_SIZE*WHEEL_LEVELS;
+    static constexpr uint8_t DUE_LIST = OVERFLOW_LIST+1;       // timers already due when they were inserted
+    static constexpr uint8_t EXPIRED_LIST = OVERFLOW_LIST+2;   // timers expired by advance() waiting to be popped
+    static constexpr uint8_t LIST_COUNT = OVERFLOW_LIST+3;
+    static constexpr uint8_t NO_LIST = 0xFF;
+    static constexpr std::size_t storage_count = slot_count ? slot_count : 1;
+
+    uint32_t m_now = 0;
+    uint8_t m_count = 0;
+    SlotIndex m_heads[LIST_COUNT];
+    SlotIndex m_expired_tail = NoSlot;
+    uint32_t m_deadline[storage_count];
+    SlotIndex m_next[storage_count];
+    SlotIndex m_prev[storage_count];
+    uint8_t m_list[storage_count];
+    uint16_t m_slack[storage_count];
+    uint32_t m_latest[storage_count];   // the deadline of a timer with slack as nextExpiry() sees it
+    uint8_t m_lax = 0;                  // timers armed with slack
+
+    void link(SlotIndex i, uint8_t list);
+    void unlink(SlotIndex i);
+    void place(SlotIndex i);
+    void gather(uint8_t list, SlotIndex& gathered);
+    void expire(SlotIndex i);
+    uint32_t earliestIn(uint8_t list) const;
+public:
+    TimerWheel()
+    {
+        for(uint8_t l=0; l<LIST_COUNT; l++)
+            m_heads[l] = NoSlot;
+        for(SlotIndex i=0; i<slot_count; i++)
+            m_list[i] = NO_LIST;
+    }
+    TimerWheel(const TimerWheel&) = delete;
+
+    uint32_t now() const { return m_now; }
+    uint8_t count() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    bool contains(SlotIndex i) const { return m_list[i] != NO_LIST; }
+    // remaining ms of the timer, 0 if it is due
+    uint32_t timeLeft(SlotIndex i) const
+    { return (int32_t)(m_deadline[i]-m_now) > 0 ? m_deadline[i]-m_now : 0; }
+
+    // ms between the deadline and now(), for a timer that has expired
+    uint32_t lateness(SlotIndex i) const
+    { return (int32_t)(m_now-m_deadline[i]) > 0 ? m_now-m_deadline[i] : 0; }
+
+    uint16_t slackOf(SlotIndex i) const { return m_slack[i]; }
+
+    // arm the timer in slot i to expire delay ms later than now(), an idle loop may let it wait slack ms more
+    void insert(SlotIndex i, uint32_t delay, uint16_t slack = 0)
+    {
+        m_deadline[i] = m_now + (delay > MAX_DELAY ? MAX_DELAY : delay);
+        m_slack[i] = slack;
+        if(slack)
+        {
+            uint32_t grid = 1;
+            while(grid < 0x8000 && grid*2 <= (uint32_t)slack+1)
+                grid *= 2;
+            m_latest[i] = (m_deadline[i]+slack) & ~(grid-1);
+            m_lax++;
+        }
+        m_count++;
+        place(i);
+    }
+    // disarm the timer in slot i, wherever it is
+    void remove(SlotIndex i)
+    {
+        if(m_list[i] == NO_LIST)
+            return;
+        if(i == m_expired_tail)
+            m_expired_tail = m_prev[i];
+        unlink(i);
+        m_count--;
+        if(m_slack[i])
+            m_lax--;
+    }
+    // ms until the earliest timer expires, 0 if some are due already, NoDeadline if the wheel is empty.
+    // a timer with slack counts at its latest point instead, so this is how long an idle loop can sleep
+    uint32_t nextExpiry() const;
+    // move the time forward, the timers expired are kept until popped by popExpired()
+    void advance(uint32_t passed_ms);
+    // take one expired timer out of the wheel, NoSlot if there is none
+    SlotIndex popExpired()
+    {
+        const SlotIndex i = m_heads[EXPIRED_LIST];
+        if(i != NoSlot)
+            remove(i);
+        return i;
+    }
+};
+
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::link(SlotIndex i, uint8_t list)
+{
+    m_list[i] = list;
+    m_prev[i] = NoSlot;
+    m_next[i] = m_heads[list];
+    if(m_heads[list] != NoSlot)
+        m_prev[m_heads[list]] = i;
+    m_heads[list] = i;
+}
+
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::unlink(SlotIndex i)
+{
+    if(m_prev[i] != NoSlot)
+        m_next[m_prev[i]] = m_next[i];
+    else
+        m_heads[m_list[i]] = m_next[i];
+    if(m_next[i] != NoSlot)
+        m_prev[m_next[i]] = m_prev[i];
+    m_list[i] = NO_LIST;
+}
+
+// put the timer into the finest level that can hold it, relative to m_now
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::place(SlotIndex i)
+{
+    const int32_t delta = m_deadline[i] - m_now;
+    if(delta <= 0)
+        return link(i, DUE_LIST);
+    for(uint8_t level=0; level<WHEEL_LEVELS; level++)
+    {   // at level n the bucket of the deadline is at most WHEEL_SIZE buckets ahead, so it is never the one just visited
+        const uint8_t shift = level*WHEEL_BITS;
+        if((uint32_t)delta < ((uint32_t)WHEEL_SIZE<<shift))
+            return link(i, level*WHEEL_SIZE + ((m_deadline[i]>>shift)&WHEEL_MASK));
+    }
+    link(i, OVERFLOW_LIST);
+}
+
+// move all timers of the list onto the scratch list, which is singly linked by m_next only
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::gather(uint8_t list, SlotIndex& gathered)
+{
+    while(m_heads[list] != NoSlot)
+    {
+        const SlotIndex i = m_heads[list];
+        unlink(i);
+        m_next[i] = gathered;
+        gathered = i;
+    }
+}
+
+// expired timers are appended, so the ones sharing a deadline are popped in the order they were inserted
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::expire(SlotIndex i)
+{
+    m_list[i] = EXPIRED_LIST;
+    m_next[i] = NoSlot;
+    m_prev[i] = m_expired_tail;
+    if(m_expired_tail != NoSlot)
+        m_next[m_expired_tail] = i;
+    else
+        m_heads[EXPIRED_LIST] = i;
+    m_expired_tail = i;
+}
+
+template<std::size_t slot_count>
+void TimerWheel<slot_count>::advance(uint32_t passed_ms)
+{
+    const uint32_t prev = m_now;
+    m_now += passed_ms;
+
+    // find how many levels entered a new bucket during (prev, m_now], coarser levels cannot move if a finer one did not
+    uint8_t moved = 0;
+    while(moved < WHEEL_LEVELS && (prev>>(moved*WHEEL_BITS)) != (m_now>>(moved*WHEEL_BITS)))
+        moved++;
+
+    // the scratch list is a stack, gather the latest buckets first so the earliest timers are handled first
+    SlotIndex gathered = NoSlot;
+    if(moved == WHEEL_LEVELS)   // the coarsest level moved, recheck the far away timers
+        gather(OVERFLOW_LIST, gathered);
+    for(uint8_t level=moved; level>0; level--)
+    {
+        const uint8_t shift = (level-1)*WHEEL_BITS;
+        const uint32_t from = prev>>shift, to = m_now>>shift;
+        const uint32_t steps = to-from < WHEEL_SIZE ? to-from : WHEEL_SIZE;
+        for(uint32_t s=steps; s>0; s--)
+            gather((level-1)*WHEEL_SIZE + ((from+s)&WHEEL_MASK), gathered);
+    }
+    gather(DUE_LIST, gathered);
+
+    while(gathered != NoSlot)
+    {   // expire or cascade down
+        const SlotIndex i = gathered;
+        gathered = m_next[i];
+        if((int32_t)(m_deadline[i]-m_now) <= 0)
+            expire(i);
+        else
+            place(i);
+    }
+}
+
+template<std::size_t slot_count>
+uint32_t TimerWheel<slot_count>::earliestIn(uint8_t list) const
+{
+    uint32_t earliest = NoDeadline;
+    for(SlotIndex i = m_heads[list]; i != NoSlot; i = m_next[i])
+        if(timeLeft(i) < earliest)
+            earliest = timeLeft(i);
+    return earliest;
+}
+
+template<std::size_t slot_count>
+uint32_t TimerWheel<slot_count>::nextExpiry() const
+{
+    if(m_heads[DUE_LIST] != NoSlot || m_heads[EXPIRED_LIST] != NoSlot)
+        return 0;
+    if(m_lax)
+    {   // the bucket order says nothing about the latest points, look at every timer
+        uint32_t earliest = NoDeadline;
+        for(SlotIndex i=0; i<slot_count; i++)
+        {
+            if(m_list[i] == NO_LIST)
+                continue;
+            const uint32_t due = m_slack[i] ? m_latest[i] : m_deadline[i];
+            const uint32_t left = (int32_t)(due-m_now) > 0 ? due-m_now : 0;
+            if(left < earliest)
+                earliest = left;
+        }
+        return earliest;
+    }
+    uint32_t earliest = earliestIn(OVERFLOW_LIST);
+    for(uint8_t level=0; level<WHEEL_LEVELS; level++)
+    {   // buckets are visited in time order, the first non-empty one of a level holds its earliest timers
+        const uint32_t slot = m_now>>(level*WHEEL_BITS);
+        for(uint8_t s=1; s<=WHEEL_SIZE; s++)
+        {
+            const uint8_t list = level*WHEEL_SIZE + ((slot+s)&WHEEL_MASK);
+            if(m_heads[list] == NoSlot)
+                continue;
+            const uint32_t left = earliestIn(list);
+            if(left < earliest)
+                earliest = left;
+            break;
+        }
+    }
+    return earliest;
+}
+
+#endif
\ No newline at end of file
@@ -47,6 +47,44 @@ namespace stl_metaprog_alternative
 
     /* --- end std::forward implementation --- */
 
+    /*
+        Implementation of std::move
+    */
+
+    template<typename T>
+    constexpr typename remove_reference<T>::type&& move(T&& t) noexcept
+    {
+        return static_cast<typename remove_reference<T>::type&&>(t);
+    }
+
+    /* --- end std::move implementation --- */
+
+    /*
+        Implementation of std::enable_if
+        ref: https://en.cppreference.com/w/cpp/types/enable_if
+    */
+
+    template<bool B, class T = void>
+    struct enable_if {};
+    
+    template<class T>
+    struct enable_if<true, T> { typedef T type; };
+
+    /* --- end std::enable_if implementation --- */
+
+    /*
+        Implementation of std::is_same
+        ref: https://en.cppreference.com/w/cpp/types/is_same
+    */
+
+    template<class T, class U>
+    struct is_same { static constexpr bool value = false; };
+
+    template<class T>
+    struct is_same<T, T> { static constexpr bool value = true; };
+
+    /* --- end std::is_same implementation --- */
+
     /*
         Implementation of std::tuple 
         ref: https://stackoverflow.com/questions/4041447/how-is-stdtuple-implemented
@@ -57,7 +95,8 @@ namespace stl_metaprog_alternative
     {
         T value;
         TupleLeaf() {}
-        TupleLeaf(T v) : value(v) {}
+        template<typename U>
+        TupleLeaf(U&& v) : value(forward<U>(v)) {}
 
     };
 
@@ -80,9 +119,12 @@ namespace stl_metaprog_alternative
     {
         TupleImpl() {}
 
-        TupleImpl(Thead head, Ttail... tail) : 
-            TupleLeaf<i, Thead>(head), 
-            TupleImpl<i+1, Ttail...>(tail...)
+        // the arguments are forwarded, so move-only elements work. a tuple of one is still copied by the copy constructor
+        template<typename Uhead, typename... Utail, typename = typename enable_if<sizeof...(Utail) == sizeof...(Ttail)
+                 && !is_same<typename remove_reference<Uhead>::type, TupleImpl>::value>::type>
+        TupleImpl(Uhead&& head, Utail&&... tail) : 
+            TupleLeaf<i, Thead>(forward<Uhead>(head)), 
+            TupleImpl<i+1, Ttail...>(forward<Utail>(tail)...)
         {}
 
         static constexpr size_t _size = 1 + TupleImpl<i+1, Ttail...>::_size;
@@ -110,6 +152,12 @@ namespace stl_metaprog_alternative
         return t.TupleLeaf<i, Thead>::value;
     }
 
+    template<size_t i, typename Thead, typename... Ttail>
+    constexpr Thead&& get(TupleImpl<i, Thead, Ttail...>&& t)
+    {
+        return move(t.TupleLeaf<i, Thead>::value);
+    }
+
     /* --- end std::tuple implementation --- */
 
     /*
@@ -153,15 +201,15 @@ namespace stl_metaprog_alternative
     */
 
     template<typename Callable, typename ...Args>
-    constexpr auto invoke(Callable&& f, Args&&... args) -> decltype(f(args...))
+    constexpr auto invoke(Callable&& f, Args&&... args) -> decltype(f(forward<Args>(args)...))
     {
-        return f(args...);
+        return f(forward<Args>(args)...);
     }
 
     template<typename Ret, typename Class, typename T, typename ...Args>
-    constexpr auto invoke(Ret (Class::*f)(Args...), T&& self, Args&&... args) -> decltype( ((*self).*f)(args...) )
+    constexpr auto invoke(Ret (Class::*f)(Args...), T&& self, Args&&... args) -> decltype( ((*self).*f)(forward<Args>(args)...) )
     {
-        return ((*self).*f)(args...);
+        return ((*self).*f)(forward<Args>(args)...);
     }
 
     /* --- end std::invoke implementation --- */
@@ -172,32 +220,20 @@ namespace stl_metaprog_alternative
     */
 
     template<typename Callable, typename ArgsTuple, size_t ...Is>
-    constexpr auto applyImpl(Callable&& f, ArgsTuple&& t, index_sequence<Is...>) -> decltype(invoke(f, get<Is>(t)...))
-    {
-        return invoke(f, get<Is>(t)...);
+    constexpr auto applyImpl(Callable&& f, ArgsTuple&& t, index_sequence<Is...>) -> decltype(invoke(f, get<Is>(forward<ArgsTuple>(t))...))
+    {   // each element is taken once, an rvalue tuple hands its elements over
+        return invoke(f, get<Is>(forward<ArgsTuple>(t))...);
     }
 
     template<typename Callable, typename ArgsTuple>
-    constexpr auto apply(Callable&& f, ArgsTuple&& t) -> decltype(applyImpl(f, t, make_index_sequence<tuple_size<ArgsTuple>::value>{}))
+    constexpr auto apply(Callable&& f, ArgsTuple&& t) 
+        -> decltype(applyImpl(f, forward<ArgsTuple>(t), make_index_sequence<tuple_size<ArgsTuple>::value>{}))
     {
-        return applyImpl(f, t, make_index_sequence<tuple_size<ArgsTuple>::value>{});
+        return applyImpl(f, forward<ArgsTuple>(t), make_index_sequence<tuple_size<ArgsTuple>::value>{});
     }
 
     /* --- end std::apply implementation --- */
 
-    /*
-        Implementation of std::enable_if
-        ref: https://en.cppreference.com/w/cpp/types/enable_if
-    */
-
-    template<bool B, class T = void>
-    struct enable_if {};
-    
-    template<class T>
-    struct enable_if<true, T> { typedef T type; };
-
-    /* --- end std::enable_if implementation --- */
-
     /*
         Implementation of std::declval
         ref: https://en.cppreference.com/w/cpp/utility/declval
@@ -236,17 +272,27 @@ namespace stl_metaprog_alternative
     */
 
     /*
-        Implementation of std::is_same
-        ref: https://en.cppreference.com/w/cpp/types/is_same
+        Implementation of std::is_trivially_copyable, the compiler knows it better than any template
+        ref: https://en.cppreference.com/w/cpp/types/is_trivially_copyable
     */
 
-    template<class T, class U>
-    struct is_same { static constexpr bool value = false; };
+    template<class T>
+    struct is_trivially_copyable { static constexpr bool value = __is_trivially_copyable(T); };
+
+    /* --- end std::is_trivially_copyable implementation --- */
+
+    /*
+        Implementation of std::is_copy_constructible
+        ref: https://en.cppreference.com/w/cpp/types/is_copy_constructible
+    */
+
+    template<class T, class = void>
+    struct is_copy_constructible { static constexpr bool value = false; };
 
     template<class T>
-    struct is_same<T, T> { static constexpr bool value = true; };
+    struct is_copy_constructible<T, decltype(void(T(declval<const T&>())))> { static constexpr bool value = true; };
 
-    /* --- end std::is_same implementation --- */
+    /* --- end std::is_copy_constructible implementation --- */
 }
 
 namespace std
@@ -256,12 +302,24 @@ namespace std
     template<typename T>
     using remove_reference = stl_metaprog_alternative::remove_reference<T>;
 
+    template<typename T>
+    constexpr T&& forward(typename remove_reference<T>::type& t) noexcept
+    {
+        return stl_metaprog_alternative::forward<T>(t);
+    }
+
     template<typename T>
     constexpr T&& forward(typename remove_reference<T>::type&& t) noexcept
     {
         return stl_metaprog_alternative::forward<T>(t);
     }
 
+    template<typename T>
+    constexpr typename remove_reference<T>::type&& move(T&& t) noexcept
+    {
+        return stl_metaprog_alternative::move(t);
+    }
+
     template<typename... Ts>
     using tuple = stl_metaprog_alternative::tuple<Ts...>;
 
@@ -281,9 +339,9 @@ namespace std
     }
 
     template<typename Callable, typename ArgsTuple>
-    constexpr auto apply(Callable&& f, ArgsTuple&& t) -> decltype(stl_metaprog_alternative::apply(f, t))
+    constexpr auto apply(Callable&& f, ArgsTuple&& t) -> decltype(stl_metaprog_alternative::apply(f, std::forward<ArgsTuple>(t)))
     {
-        return stl_metaprog_alternative::apply(f, t);
+        return stl_metaprog_alternative::apply(f, std::forward<ArgsTuple>(t));
     }
     
     template<size_t... Ints>
@@ -313,6 +371,65 @@ namespace std
     template<class T, class U>
     struct is_same : stl_metaprog_alternative::is_same<T, U> {};
 
+    template<class T>
+    struct is_trivially_copyable : stl_metaprog_alternative::is_trivially_copyable<T> {};
+
+    template<class T>
+    struct is_copy_constructible : stl_metaprog_alternative::is_copy_constructible<T> {};
+
+#ifdef __cpp_impl_coroutine
+    /*
+        Implementation of <coroutine>, what the compiler looks up in std for co_await, over the gcc builtins
+        ref: https://en.cppreference.com/w/cpp/header/coroutine
+    */
+
+    template<typename Ret, typename ...Args>
+    struct coroutine_traits { using promise_type = typename Ret::promise_type; };
+
+    template<typename Promise = void>
+    struct coroutine_handle;
+
+    template<>
+    struct coroutine_handle<void>
+    {
+    protected:
+        void* m_frame = nullptr;
+    public:
+        constexpr coroutine_handle() noexcept {}
+        static coroutine_handle from_address(void* address) noexcept { coroutine_handle h; h.m_frame = address; return h; }
+        constexpr void* address() const noexcept { return m_frame; }
+        constexpr explicit operator bool() const noexcept { return m_frame; }
+        bool done() const noexcept { return __builtin_coro_done(m_frame); }
+        void operator()() const { resume(); }
+        void resume() const { __builtin_coro_resume(m_frame); }
+        void destroy() const { __builtin_coro_destroy(m_frame); }
+    };
+
+    template<typename Promise>
+    struct coroutine_handle : coroutine_handle<>
+    {
+        static coroutine_handle from_address(void* address) noexcept { coroutine_handle h; h.m_frame = address; return h; }
+        static coroutine_handle from_promise(Promise& promise) noexcept
+        { return from_address(__builtin_coro_promise((char*)&promise, __alignof(Promise), true)); }
+        Promise& promise() const { return *static_cast<Promise*>(__builtin_coro_promise(m_frame, __alignof(Promise), false)); }
+    };
+
+    struct suspend_always
+    {
+        constexpr bool await_ready() const noexcept { return false; }
+        constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+        constexpr void await_resume() const noexcept {}
+    };
+
+    struct suspend_never
+    {
+        constexpr bool await_ready() const noexcept { return true; }
+        constexpr void await_suspend(coroutine_handle<>) const noexcept {}
+        constexpr void await_resume() const noexcept {}
+    };
+
+    /* --- end <coroutine> implementation --- */
+#endif
 }
 
 #endif
\ No newline at end of file
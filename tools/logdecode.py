@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""
+The host side of Log.h: the string table and the decoder of the binary records.
+
+    logdecode.py table SOURCE... > log_table.json
+        scans the sources (files or directories) for LOG_DEBUG/INFO/WARN/ERROR("format", ...) and writes the table
+        of id -> level, format, file and line. Two formats with the same id are an error, reword one of them.
+    logdecode.py decode log_table.json [CAPTURE]
+        reads the COBS framed records from CAPTURE (a file, a serial device, stdin without it) and prints a line each.
+
+The id is FNV-1a over the level digit and the bytes of the format, folded to 16 bits, the same as log_impl::id().
+The sources are read as latin-1, so every byte of a literal, UTF-8 or not, is hashed as the compiler sees it.
+"""
+
+import json
+import os
+import re
+import struct
+import sys
+
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR"]
+SOURCE_SUFFIXES = (".h", ".hpp", ".c", ".cc", ".cpp", ".ino")
+
+CALL = re.compile(r'\bLOG_(DEBUG|INFO|WARN|ERROR)\s*\(\s*((?:"(?:[^"\\\n]|\\.)*"\s*)+)')
+LITERAL = re.compile(r'"((?:[^"\\\n]|\\.)*)"')
+ESCAPE = re.compile(r'\\(x[0-9a-fA-F]+|[0-7]{1,3}|.)')
+SPEC = re.compile(r'%([-+ #0-9.]*)(hh|h|ll|l|L|j|z|t)?([diuxXocfFeEgGs%])')
+COMMENT = re.compile(r'//[^\n]*|/\*.*?\*/|"(?:[^"\\\n]|\\.)*"|\'(?:[^\'\\\n]|\\.)*\'', re.S)
+SIMPLE_ESCAPES = {"n": "\n", "r": "\r", "t": "\t", "0": "\0", "\\": "\\", '"': '"', "'": "'",
+                  "a": "\a", "b": "\b", "f": "\f", "v": "\v", "?": "?"}
+
+
+def unescape(literal):
+    def one(m):
+        e = m.group(1)
+        if e[0] == "x":
+            return chr(int(e[1:], 16))
+        if e[0] in "01234567":
+            return chr(int(e, 8))
+        return SIMPLE_ESCAPES.get(e, e)
+    return ESCAPE.sub(one, literal)
+
+
+def uncomment(text):
+    # comments to blanks, keeping the lines where they are, so the examples in them do not count
+    def one(m):
+        s = m.group(0)
+        return s if s[0] in "\"'" else re.sub(r"[^\n]", " ", s)
+    return COMMENT.sub(one, text)
+
+
+def log_id(level, fmt):
+    h = ((2166136261 ^ ord(str(level))) * 16777619) & 0xFFFFFFFF
+    for b in fmt.encode("latin-1"):
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return (h >> 16) ^ (h & 0xFFFF)
+
+
+def sources(paths):
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, files in os.walk(path):
+                for name in sorted(files):
+                    if name.endswith(SOURCE_SUFFIXES):
+                        yield os.path.join(root, name)
+        else:
+            yield path
+
+
+def table(paths):
+    entries, clashes = {}, 0
+    for path in sources(paths):
+        with open(path, encoding="latin-1") as f:     # one char per byte, \x and octal escapes are bytes too
+            text = uncomment(f.read())
+        for m in CALL.finditer(text):
+            level = LEVELS.index(m.group(1))
+            fmt = "".join(unescape(s) for s in LITERAL.findall(m.group(2)))
+            line = text.count("\n", 0, m.start()) + 1
+            key = "%04x" % log_id(level, fmt)
+            text_fmt = fmt.encode("latin-1").decode("utf-8", errors="replace")
+            entry = {"level": LEVELS[level], "format": text_fmt, "file": path, "line": line}
+            old = entries.get(key)
+            if old and (old["level"], old["format"]) != (entry["level"], entry["format"]):
+                print("logdecode: id %s of %s:%d clashes with %s:%d, reword one of them"
+                      % (key, path, line, old["file"], old["line"]), file=sys.stderr)
+                clashes += 1
+            entries.setdefault(key, entry)
+    json.dump(entries, sys.stdout, indent=1, sort_keys=True)
+    print()
+    return 1 if clashes else 0
+
+
+def frames(stream):
+    buffer = bytearray()
+    while True:
+        chunk = stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+        if not chunk:
+            return
+        for b in chunk:
+            if b:
+                buffer.append(b)
+            elif buffer:
+                yield bytes(buffer)
+                buffer.clear()
+
+
+def cobs_decode(frame):
+    out, i = bytearray(), 0
+    while i < len(frame):
+        code = frame[i]
+        if i + code > len(frame):
+            raise ValueError("block runs past the end")
+        out += frame[i+1:i+code]
+        i += code
+        if code != 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+class Reader:
+    def __init__(self, data):
+        self.data, self.at = data, 0
+
+    def byte(self):
+        if self.at >= len(self.data):
+            raise ValueError("record too short")
+        self.at += 1
+        return self.data[self.at - 1]
+
+    def varint(self):
+        v, shift = 0, 0
+        while True:
+            b = self.byte()
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if b < 0x80:
+                return (v >> 1) ^ -(v & 1)     # zigzag
+
+    def take(self, n):
+        if self.at + n > len(self.data):
+            raise ValueError("record too short")
+        self.at += n
+        return self.data[self.at - n:self.at]
+
+
+def render(fmt, reader):
+    def one(m):
+        flags, length, conversion = m.groups()
+        if conversion == "%":
+            return "%"
+        if conversion in "diuxXoc":
+            v = reader.varint()
+            if conversion in "uxXo":
+                v &= (1 << (64 if length in ("ll", "j") else 32)) - 1
+            elif conversion == "c":
+                v = chr(v & 0xFF)
+            return ("%" + flags + {"i": "d", "u": "d"}.get(conversion, conversion)) % v
+        if conversion in "fFeEgG":
+            return ("%" + flags + conversion) % struct.unpack("<f", reader.take(4))[0]
+        return ("%" + flags + "s") % reader.take(reader.byte()).decode("utf-8", errors="replace")
+    text = SPEC.sub(one, fmt)
+    if reader.at != len(reader.data):
+        raise ValueError("%d bytes left over" % (len(reader.data) - reader.at))
+    return text
+
+
+def decode(table_path, capture):
+    with open(table_path) as f:
+        entries = json.load(f)
+    stream = open(capture, "rb", buffering=0) if capture else sys.stdin.buffer
+    for frame in frames(stream):
+        try:
+            record = cobs_decode(frame)
+            if len(record) < 2:
+                raise ValueError("no id")
+            key = "%04x" % (record[0] | record[1] << 8)
+            entry = entries.get(key)
+            if entry is None:
+                raise ValueError("unknown id " + key)
+            text = render(entry["format"], Reader(record[2:]))
+            print("[%s] %s" % (entry["level"], text.rstrip("\r\n")), flush=True)
+        except ValueError as e:
+            print("logdecode: broken record (%s): %s" % (e, frame.hex()), file=sys.stderr)
+    return 0
+
+
+def main(argv):
+    if len(argv) >= 2 and argv[0] == "table":
+        return table(argv[1:])
+    if len(argv) in (2, 3) and argv[0] == "decode":
+        return decode(argv[1], argv[2] if len(argv) == 3 else None)
+    print(__doc__.strip(), file=sys.stderr)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))